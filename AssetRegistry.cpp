@@ -0,0 +1,111 @@
+#include "AssetRegistry.h"
+#include "GLState.h"
+
+#include <iostream>
+
+AssetRegistry::~AssetRegistry()
+{
+	Clear();
+}
+
+ModelHandle AssetRegistry::AddModel(std::unique_ptr<Model> model, const std::string& name)
+{
+	ModelHandle handle = models.Add(std::move(model));
+	if (!name.empty())
+		modelNames[name] = handle;
+	return handle;
+}
+
+ModelHandle AssetRegistry::FindModel(const std::string& name) const
+{
+	auto found = modelNames.find(name);
+	return found != modelNames.end() ? found->second : ModelHandle();
+}
+
+Model* AssetRegistry::Get(ModelHandle handle) const
+{
+	return models.Get(handle);
+}
+
+ShaderHandle AssetRegistry::LoadShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+	std::string key = vertexPath + '\n' + fragmentPath + '\n' + defines;
+	auto found = shaderSources.find(key);
+	if (found != shaderSources.end() && shaders.Get(found->second))
+		return found->second;
+
+	std::unique_ptr<Shader> shader = std::make_unique<Shader>();
+	shader->load(vertexPath, fragmentPath, defines);
+	ShaderHandle handle = shaders.Add(std::move(shader));
+	shaderSources[key] = handle;
+	return handle;
+}
+
+Shader* AssetRegistry::Get(ShaderHandle handle) const
+{
+	return shaders.Get(handle);
+}
+
+void AssetRegistry::Unload(ModelHandle handle)
+{
+	std::unique_ptr<Model> model = models.Remove(handle);
+	if (!model)
+		return;
+
+	for (auto it = modelNames.begin(); it != modelNames.end();)
+		it = it->second == handle ? modelNames.erase(it) : std::next(it);
+	Retire(std::shared_ptr<Model>(std::move(model)));
+}
+
+void AssetRegistry::Unload(ShaderHandle handle)
+{
+	std::unique_ptr<Shader> shader = shaders.Remove(handle);
+	if (shader)
+		Retire(std::shared_ptr<Shader>(shader.release(), DeleteShader));
+}
+
+void AssetRegistry::EndFrame()
+{
+	++frame;
+	while (!retired.empty() && retired.front().frame <= frame)
+		retired.pop_front();
+}
+
+void AssetRegistry::Clear()
+{
+	retired.clear();
+	shaders.ForEach([](Shader& shader)
+	{
+		std::cout << "Shader program destroyed with ID : " << shader.ID << std::endl;
+		GLState::Instance().DeleteProgram(shader.ID);
+	});
+	models.Clear();
+	shaders.Clear();
+	modelNames.clear();
+	shaderSources.clear();
+}
+
+size_t AssetRegistry::GetModelCount() const
+{
+	return models.GetCount();
+}
+
+size_t AssetRegistry::GetPendingDestructionCount() const
+{
+	return retired.size();
+}
+
+void AssetRegistry::Retire(std::shared_ptr<void> asset)
+{
+	Retired entry;
+	entry.frame = frame + FRAMES_IN_FLIGHT;
+	entry.asset = std::move(asset);
+	retired.push_back(std::move(entry));
+}
+
+void AssetRegistry::DeleteShader(Shader* shader)
+{
+	std::cout << "Shader program destroyed with ID : " << shader->ID << std::endl;
+	GLState::Instance().DeleteProgram(shader->ID);
+	delete shader;
+}
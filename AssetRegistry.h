@@ -0,0 +1,184 @@
+#pragma once
+
+#include "Model.h"
+#include "Shader.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class AssetType : uint32_t
+{
+	MODEL,
+	SHADER
+};
+
+// 32-bit reference to an asset of an AssetRegistry: the index of its slot, the generation of the slot when the asset
+// was added and the asset type. Copies are plain integer copies. A handle to an unloaded asset fails the generation
+// check and resolves to nullptr instead of dangling. The default handle is null.
+template<AssetType Type>
+struct AssetHandle
+{
+	static const uint32_t INDEX_BITS		= 20;
+	static const uint32_t GENERATION_BITS	= 10;
+	static const uint32_t MAX_INDEX			= (1u << INDEX_BITS) - 1;
+	static const uint32_t MAX_GENERATION	= (1u << GENERATION_BITS) - 1;
+
+	uint32_t value = 0;
+
+	static AssetHandle Make(uint32_t index, uint32_t generation)
+	{
+		AssetHandle handle;
+		handle.value = index | (generation << INDEX_BITS) | (uint32_t(Type) << (INDEX_BITS + GENERATION_BITS));
+		return handle;
+	}
+
+	// Not null. The asset may still have been unloaded since.
+	bool     IsValid() const { return value != 0; }
+	uint32_t GetIndex() const { return value & MAX_INDEX; }
+	uint32_t GetGeneration() const { return (value >> INDEX_BITS) & MAX_GENERATION; }
+
+	bool operator==(const AssetHandle& other) const { return value == other.value; }
+	bool operator!=(const AssetHandle& other) const { return value != other.value; }
+};
+
+typedef AssetHandle<AssetType::MODEL>	ModelHandle;
+typedef AssetHandle<AssetType::SHADER>	ShaderHandle;
+
+// Dense slot array of one asset type. Removing an asset bumps the generation of its slot, which is then reused.
+template<typename T, AssetType Type>
+class AssetPool
+{
+public:
+	AssetHandle<Type> Add(std::unique_ptr<T> asset)
+	{
+		uint32_t index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			index = uint32_t(slots.size());
+			slots.emplace_back();
+		}
+		slots[index].asset = std::move(asset);
+		++count;
+		return AssetHandle<Type>::Make(index, slots[index].generation);
+	}
+
+	T* Get(AssetHandle<Type> handle) const
+	{
+		uint32_t index = handle.GetIndex();
+		if (!handle.IsValid() || index >= slots.size() || slots[index].generation != handle.GetGeneration())
+			return nullptr;
+		return slots[index].asset.get();
+	}
+
+	// Hands the asset back, empty if the handle is stale. Handles to it stop resolving right away.
+	std::unique_ptr<T> Remove(AssetHandle<Type> handle)
+	{
+		if (!Get(handle))
+			return nullptr;
+
+		Slot& slot = slots[handle.GetIndex()];
+		std::unique_ptr<T> asset = std::move(slot.asset);
+		// Generation 0 is skipped, so that no live handle is ever null.
+		slot.generation = slot.generation == AssetHandle<Type>::MAX_GENERATION ? 1 : slot.generation + 1;
+		freeSlots.push_back(handle.GetIndex());
+		--count;
+		return asset;
+	}
+
+	// Asset of every live slot, for teardown.
+	template<typename F>
+	void ForEach(F function) const
+	{
+		for (const Slot& slot : slots)
+		{
+			if (slot.asset)
+				function(*slot.asset);
+		}
+	}
+
+	void Clear()
+	{
+		slots.clear();
+		freeSlots.clear();
+		count = 0;
+	}
+
+	size_t GetCount() const { return count; }
+
+private:
+	struct Slot
+	{
+		std::unique_ptr<T> asset;
+		uint32_t           generation = 1;
+	};
+
+	std::vector<Slot>     slots;
+	std::vector<uint32_t> freeSlots;
+	size_t                count = 0;
+};
+
+// Owns the engine's models and shaders and hands out handles to them, so components store 4 bytes instead of a
+// counted pointer. Textures stay with the texture cache, which already counts references to them. Unloading invalidates handles at once
+// but destroys the asset FRAMES_IN_FLIGHT frames later, once the GPU no longer reads its buffers, textures or
+// program. Context thread only.
+class AssetRegistry
+{
+public:
+	// Frames the GPU may lag behind, as for the streaming buffer and the upload queue.
+	static const unsigned int FRAMES_IN_FLIGHT = 3;
+
+	~AssetRegistry();
+
+	// Takes ownership of the model. A non-empty name makes it findable by FindModel(), replacing any model by that
+	// name in the lookup.
+	ModelHandle        AddModel(std::unique_ptr<Model> model, const std::string& name = "");
+	ModelHandle        FindModel(const std::string& name) const;
+	Model*             Get(ModelHandle handle) const;
+
+	// Compiles the program once per set of sources. The registry deletes it when unloaded.
+	ShaderHandle       LoadShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+	Shader*            Get(ShaderHandle handle) const;
+
+	// Stale handles are ignored.
+	void               Unload(ModelHandle handle);
+	void               Unload(ShaderHandle handle);
+
+	// Call once per rendered frame. Destroys the assets unloaded FRAMES_IN_FLIGHT frames ago.
+	void               EndFrame();
+	// Destroys every asset right away. The GPU must be idle, e.g. when the engine shuts down.
+	void               Clear();
+
+	size_t             GetModelCount() const;
+	size_t             GetPendingDestructionCount() const;
+
+private:
+	// An unloaded asset and the frame from which it may be destroyed. The deleter of the type-erased pointer runs
+	// the asset's teardown.
+	struct Retired
+	{
+		unsigned long long    frame = 0;
+		std::shared_ptr<void> asset;
+	};
+
+	AssetPool<Model, AssetType::MODEL>					models;
+	AssetPool<Shader, AssetType::SHADER>				shaders;
+
+	std::unordered_map<std::string, ModelHandle>		modelNames;
+	std::unordered_map<std::string, ShaderHandle>		shaderSources;
+
+	std::deque<Retired>									retired;
+	unsigned long long									frame	= 0;
+
+	void               Retire(std::shared_ptr<void> asset);
+	static void        DeleteShader(Shader* shader);
+};
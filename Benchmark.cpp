@@ -0,0 +1,217 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	struct Metric
+	{
+		const char* name;
+		float BenchmarkSummary::* value;
+		bool gpu;
+	};
+
+	// Metrics in the JSON summary, and those compared against a baseline.
+	const Metric SUMMARY_METRICS[] =
+	{
+		{ "cpu_avg_ms", &BenchmarkSummary::cpuAverage, false },
+		{ "cpu_p50_ms", &BenchmarkSummary::cpuP50, false },
+		{ "cpu_p95_ms", &BenchmarkSummary::cpuP95, false },
+		{ "cpu_p99_ms", &BenchmarkSummary::cpuP99, false },
+		{ "cpu_max_ms", &BenchmarkSummary::cpuMax, false },
+		{ "gpu_avg_ms", &BenchmarkSummary::gpuAverage, true },
+		{ "gpu_p50_ms", &BenchmarkSummary::gpuP50, true },
+		{ "gpu_p95_ms", &BenchmarkSummary::gpuP95, true },
+		{ "gpu_p99_ms", &BenchmarkSummary::gpuP99, true },
+		{ "gpu_max_ms", &BenchmarkSummary::gpuMax, true },
+		{ "draw_calls_avg", &BenchmarkSummary::drawCallsAverage, false },
+		{ "triangles_avg", &BenchmarkSummary::trianglesAverage, false },
+	};
+
+	// Single frame spikes are too noisy to fail a run on.
+	const char* COMPARED_METRICS[] = { "cpu_avg_ms", "cpu_p95_ms", "gpu_avg_ms", "gpu_p95_ms", "draw_calls_avg", "triangles_avg" };
+
+	float Percentile(const std::vector<float>& sorted, float fraction)
+	{
+		return sorted.empty() ? 0.0f : sorted[std::min(sorted.size() - 1, size_t(fraction * sorted.size()))];
+	}
+}
+
+void Benchmark::Record(unsigned long long frame, float cpuMs, float gpuMs, unsigned int drawCalls, unsigned long long triangles)
+{
+	if (skippedFrames < warmupFrames)
+	{
+		++skippedFrames;
+		return;
+	}
+	samples.push_back({ frame, cpuMs, gpuMs, drawCalls, triangles });
+}
+
+void Benchmark::Clear()
+{
+	samples.clear();
+	skippedFrames = 0;
+}
+
+const std::vector<BenchmarkSample>& Benchmark::GetSamples() const
+{
+	return samples;
+}
+
+BenchmarkSummary Benchmark::Summarize() const
+{
+	BenchmarkSummary summary;
+	summary.frames = (unsigned int)samples.size();
+	if (samples.empty())
+		return summary;
+
+	std::vector<float> cpu, gpu;
+	double cpuSum = 0.0, gpuSum = 0.0, drawCallSum = 0.0, triangleSum = 0.0;
+	for (const BenchmarkSample& sample : samples)
+	{
+		cpu.push_back(sample.cpuMs);
+		gpu.push_back(sample.gpuMs);
+		cpuSum += sample.cpuMs;
+		gpuSum += sample.gpuMs;
+		drawCallSum += sample.drawCalls;
+		triangleSum += double(sample.triangles);
+	}
+	std::sort(cpu.begin(), cpu.end());
+	std::sort(gpu.begin(), gpu.end());
+
+	double count = double(samples.size());
+	summary.cpuAverage = float(cpuSum / count);
+	summary.cpuP50 = Percentile(cpu, 0.5f);
+	summary.cpuP95 = Percentile(cpu, 0.95f);
+	summary.cpuP99 = Percentile(cpu, 0.99f);
+	summary.cpuMax = cpu.back();
+	summary.gpuAverage = float(gpuSum / count);
+	summary.gpuP50 = Percentile(gpu, 0.5f);
+	summary.gpuP95 = Percentile(gpu, 0.95f);
+	summary.gpuP99 = Percentile(gpu, 0.99f);
+	summary.gpuMax = gpu.back();
+	summary.drawCallsAverage = float(drawCallSum / count);
+	summary.trianglesAverage = float(triangleSum / count);
+	return summary;
+}
+
+bool Benchmark::WriteCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::BENCHMARK::Could not write " << path << std::endl;
+		return false;
+	}
+
+	file << "frame,cpu_ms,gpu_ms,draw_calls,triangles" << std::endl;
+	for (const BenchmarkSample& sample : samples)
+		file << sample.frame << ',' << sample.cpuMs << ',' << sample.gpuMs << ',' << sample.drawCalls << ',' << sample.triangles << std::endl;
+	return true;
+}
+
+bool Benchmark::WriteJson(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::BENCHMARK::Could not write " << path << std::endl;
+		return false;
+	}
+
+	BenchmarkSummary summary = Summarize();
+	file << "{" << std::endl;
+	file << "\t\"summary\": {" << std::endl;
+	file << "\t\t\"frames\": " << summary.frames;
+	for (const Metric& metric : SUMMARY_METRICS)
+		file << "," << std::endl << "\t\t\"" << metric.name << "\": " << summary.*metric.value;
+	file << std::endl << "\t}," << std::endl;
+
+	file << "\t\"frames\": [";
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		const BenchmarkSample& sample = samples[i];
+		file << (i ? "," : "") << std::endl << "\t\t{ \"frame\": " << sample.frame << ", \"cpu_ms\": " << sample.cpuMs
+			<< ", \"gpu_ms\": " << sample.gpuMs << ", \"draw_calls\": " << sample.drawCalls << ", \"triangles\": " << sample.triangles << " }";
+	}
+	file << std::endl << "\t]" << std::endl << "}" << std::endl;
+	return true;
+}
+
+bool Benchmark::LoadSummary(const std::string& path, BenchmarkSummary& summary)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::BENCHMARK::Could not read " << path << std::endl;
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string text = buffer.str();
+
+	// Only our own output is read, so looking up each key inside the summary object is enough.
+	size_t begin = text.find("\"summary\"");
+	size_t end = text.find('}', begin);
+	if (begin == std::string::npos || end == std::string::npos)
+	{
+		std::cout << "ERROR::BENCHMARK::No summary in " << path << std::endl;
+		return false;
+	}
+	std::string object = text.substr(begin, end - begin);
+
+	auto read = [&object](const std::string& key, double& value)
+	{
+		size_t position = object.find("\"" + key + "\":");
+		if (position == std::string::npos)
+			return false;
+		value = std::strtod(object.c_str() + position + key.size() + 3, nullptr);
+		return true;
+	};
+
+	double value = 0.0;
+	if (!read("frames", value))
+	{
+		std::cout << "ERROR::BENCHMARK::No frame count in " << path << std::endl;
+		return false;
+	}
+	summary.frames = (unsigned int)value;
+	for (const Metric& metric : SUMMARY_METRICS)
+	{
+		if (!read(metric.name, value))
+		{
+			std::cout << "ERROR::BENCHMARK::Missing " << metric.name << " in " << path << std::endl;
+			return false;
+		}
+		summary.*metric.value = float(value);
+	}
+	return true;
+}
+
+unsigned int Benchmark::CompareToBaseline(const BenchmarkSummary& baseline, float threshold, std::ostream& stream) const
+{
+	BenchmarkSummary current = Summarize();
+	bool compareGpu = current.gpuAverage > 0.0f && baseline.gpuAverage > 0.0f;
+
+	unsigned int regressions = 0;
+	for (const Metric& metric : SUMMARY_METRICS)
+	{
+		bool compared = std::find_if(std::begin(COMPARED_METRICS), std::end(COMPARED_METRICS),
+			[&metric](const char* name) { return std::string(name) == metric.name; }) != std::end(COMPARED_METRICS);
+		if (!compared || (metric.gpu && !compareGpu))
+			continue;
+
+		float before = baseline.*metric.value, after = current.*metric.value;
+		if (before > 0.0f && after > before * (1.0f + threshold))
+		{
+			stream << "WARNING::BENCHMARK::Regression in " << metric.name << ": " << before << " -> " << after
+				<< " (+" << (after / before - 1.0f) * 100.0f << "%)" << std::endl;
+			++regressions;
+		}
+	}
+	return regressions;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkSample
+{
+	unsigned long long frame;
+	// CPU time spent on the frame, from the start of the simulation to the end of Render().
+	float              cpuMs;
+	// Latest completed GPU time of the frame pass. Queries resolve a few frames late, 0 without GPU profiling.
+	float              gpuMs;
+	unsigned int       drawCalls;
+	unsigned long long triangles;
+};
+
+struct BenchmarkSummary
+{
+	unsigned int frames				= 0;
+	float        cpuAverage			= 0.0f;
+	float        cpuP50				= 0.0f;
+	float        cpuP95				= 0.0f;
+	float        cpuP99				= 0.0f;
+	float        cpuMax				= 0.0f;
+	float        gpuAverage			= 0.0f;
+	float        gpuP50				= 0.0f;
+	float        gpuP95				= 0.0f;
+	float        gpuP99				= 0.0f;
+	float        gpuMax				= 0.0f;
+	float        drawCallsAverage	= 0.0f;
+	float        trianglesAverage	= 0.0f;
+};
+
+// Per-frame timings and draw statistics of a benchmark run. Results are written as CSV (one row per frame) or JSON
+// (summary and frames), and the summary of a stored JSON run serves as the baseline of later ones.
+class Benchmark
+{
+public:
+	// Frames at the start that are not recorded, while shaders, pools and caches warm up.
+	unsigned int                        warmupFrames	= 30;
+
+	void                                Record(unsigned long long frame, float cpuMs, float gpuMs, unsigned int drawCalls,
+		unsigned long long triangles);
+	void                                Clear();
+	const std::vector<BenchmarkSample>& GetSamples() const;
+	BenchmarkSummary                    Summarize() const;
+
+	bool                                WriteCsv(const std::string& path) const;
+	bool                                WriteJson(const std::string& path) const;
+	// Reads the summary of a file written by WriteJson().
+	static bool                         LoadSummary(const std::string& path, BenchmarkSummary& summary);
+	// Prints every metric that is worse than in the baseline by more than threshold, a fraction of the baseline value,
+	// and returns how many there are. GPU times are skipped if either run has none.
+	unsigned int                        CompareToBaseline(const BenchmarkSummary& baseline, float threshold,
+		std::ostream& stream) const;
+
+private:
+	std::vector<BenchmarkSample> samples;
+	unsigned int                 skippedFrames	= 0;
+};
@@ -0,0 +1,87 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+void CameraPath::AddKeyframe(const CameraKeyframe& keyframe)
+{
+	auto position = std::upper_bound(keyframes.begin(), keyframes.end(), keyframe.time,
+		[](float time, const CameraKeyframe& k) { return time < k.time; });
+	keyframes.insert(position, keyframe);
+}
+
+bool CameraPath::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::CAMERA_PATH::Could not read " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	unsigned int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		++lineNumber;
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream stream(line);
+		CameraKeyframe keyframe;
+		if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch))
+		{
+			std::cout << "ERROR::CAMERA_PATH::Malformed keyframe in " << path << " at line " << lineNumber << std::endl;
+			return false;
+		}
+		AddKeyframe(keyframe);
+	}
+	return true;
+}
+
+void CameraPath::Clear()
+{
+	keyframes.clear();
+}
+
+bool CameraPath::IsEmpty() const
+{
+	return keyframes.empty();
+}
+
+float CameraPath::GetDuration() const
+{
+	return keyframes.empty() ? 0.0f : keyframes.back().time;
+}
+
+CameraKeyframe CameraPath::Evaluate(float time) const
+{
+	if (keyframes.empty())
+		return CameraKeyframe{ time, glm::vec3(0.0f), -90.0f, 0.0f };
+	if (time <= keyframes.front().time)
+		return keyframes.front();
+	if (time >= keyframes.back().time)
+		return keyframes.back();
+
+	size_t next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+		[](float t, const CameraKeyframe& k) { return t < k.time; }) - keyframes.begin();
+	const CameraKeyframe& a = keyframes[next - 1];
+	const CameraKeyframe& b = keyframes[next];
+	// The path is extended past its ends by repeating the end points.
+	const glm::vec3& p0 = keyframes[next > 1 ? next - 2 : next - 1].position;
+	const glm::vec3& p3 = keyframes[std::min(next + 1, keyframes.size() - 1)].position;
+
+	float t = (b.time > a.time) ? (time - a.time) / (b.time - a.time) : 1.0f;
+	float t2 = t * t, t3 = t2 * t;
+
+	CameraKeyframe result;
+	result.time = time;
+	result.position = 0.5f * ((2.0f * a.position) + (-p0 + b.position) * t
+		+ (2.0f * p0 - 5.0f * a.position + 4.0f * b.position - p3) * t2
+		+ (-p0 + 3.0f * a.position - 3.0f * b.position + p3) * t3);
+	result.yaw = a.yaw + (b.yaw - a.yaw) * t;
+	result.pitch = a.pitch + (b.pitch - a.pitch) * t;
+	return result;
+}
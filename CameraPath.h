@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+struct CameraKeyframe
+{
+	// Seconds from the start of the path.
+	float     time;
+	glm::vec3 position;
+	// Degrees, as in cCamera.
+	float     yaw;
+	float     pitch;
+};
+
+// A scripted camera flight. Positions follow a Catmull-Rom spline through the keyframes, angles are interpolated
+// linearly. Before the first and after the last keyframe the camera holds still.
+class CameraPath
+{
+public:
+	void           AddKeyframe(const CameraKeyframe& keyframe);
+	// Reads one keyframe per line as "time x y z yaw pitch". Lines starting with # are skipped. Returns false if the
+	// file cannot be read or a line is malformed.
+	bool           Load(const std::string& path);
+	void           Clear();
+
+	bool           IsEmpty() const;
+	float          GetDuration() const;
+	CameraKeyframe Evaluate(float time) const;
+
+private:
+	// Sorted by time.
+	std::vector<CameraKeyframe> keyframes;
+};
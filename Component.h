@@ -10,7 +10,7 @@
 #include "Enums.h"
 #include "Shader.h"
 #include "Input.h"
-#include "Model.h"
+#include "AssetRegistry.h"
 
 enum class ComponentType
 {
@@ -45,6 +45,9 @@ struct cTransform : Component
 	glm::vec3	up				= { 0.0f, 1.0f, 0.0f };
 	glm::vec3	right;
 	glm::quat   orientation		= { glm::vec3(0.0, 0.0, 0.0) };
+	// State at the previous simulation step, rendering interpolates between it and the current state.
+	glm::vec3	previousPosition	= { 0.0f, 0.0f, 0.0f };
+	glm::quat	previousOrientation	= { glm::vec3(0.0, 0.0, 0.0) };
 
 	cTransform()
 	{
@@ -52,13 +55,13 @@ struct cTransform : Component
 		type = ComponentType::TRANSFORM;
 	}
 	cTransform(glm::vec3 pos, glm::vec3 front, glm::vec3 up, glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f))
-		: position{ pos }, front{ front }, up{ up }, scale{ scale }
+		: position{ pos }, front{ front }, up{ up }, scale{ scale }, previousPosition{ pos }
 	{
 		right = glm::normalize(glm::cross(front, up));
 		type = ComponentType::TRANSFORM;
 	}
 	explicit cTransform(glm::vec3 pos)
-		: position{ pos }
+		: position{ pos }, previousPosition{ pos }
 	{
 		right = glm::normalize(glm::cross(front, up));
 		type = ComponentType::TRANSFORM;
@@ -162,15 +165,20 @@ struct cSpotLight : Component
 
 struct cModel : Component
 {
-	std::shared_ptr<Model> model		= nullptr;
+	// Resolved through the engine's asset registry, null or stale handles draw nothing.
+	ModelHandle			   model;
 	bool				   isOutlined   = false;
 	glm::vec3			   outlineColor = { 0.0f, 0.0f, 0.0f };
+	// Level of detail selected for this frame.
+	unsigned int		   lod			= 0;
+	// Cleared by occlusion culling when the entity is hidden or outside the view this frame.
+	bool				   isVisible	= true;
 	
 	cModel() 
 	{
 		type = ComponentType::MODEL;
 	}
-	cModel(std::shared_ptr<Model> Model) : model{ Model } 
+	cModel(ModelHandle Model) : model{ Model } 
 	{
 		type = ComponentType::MODEL;
 	}
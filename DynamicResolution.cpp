@@ -0,0 +1,35 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+float DynamicResolution::Update(float frameTime)
+{
+	if (frameTime <= 0.0f || targetFrameTime <= 0.0f)
+		return quantizedScale;
+
+	// Positive when there is time to spare.
+	float error = (targetFrameTime - frameTime) / targetFrameTime;
+	float change = proportionalGain * (error - previousError) + integralGain * error
+		+ derivativeGain * (error - 2.0f * previousError + olderError);
+	olderError = previousError;
+	previousError = error;
+
+	scale = std::min(maxScale, std::max(minScale, scale + change));
+	quantizedScale = scaleStep > 0.0f ? std::floor(scale / scaleStep + 0.5f) * scaleStep : scale;
+	quantizedScale = std::min(maxScale, std::max(minScale, quantizedScale));
+	return quantizedScale;
+}
+
+float DynamicResolution::GetScale() const
+{
+	return quantizedScale;
+}
+
+void DynamicResolution::Reset()
+{
+	scale = maxScale;
+	quantizedScale = maxScale;
+	previousError = 0.0f;
+	olderError = 0.0f;
+}
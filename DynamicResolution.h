@@ -0,0 +1,29 @@
+#pragma once
+
+// Chooses the scene's resolution scale from measured frame times with a PID controller. The controller works in
+// velocity form: each update changes the scale by the proportional, integral and derivative terms of the relative
+// frame time error, so clamping the scale cannot wind the integral up.
+class DynamicResolution
+{
+public:
+	// Milliseconds.
+	float targetFrameTime	= 16.0f;
+	float minScale			= 0.5f;
+	float maxScale			= 1.0f;
+	float proportionalGain	= 0.2f;
+	float integralGain		= 0.03f;
+	float derivativeGain	= 0.05f;
+	// The returned scale is a multiple of this, so render targets are not recreated for every small change.
+	float scaleStep			= 0.05f;
+
+	// Feeds the last frame time and returns the scale to render the next frame at.
+	float Update(float frameTime);
+	float GetScale() const;
+	void  Reset();
+
+private:
+	float scale				= 1.0f;
+	float quantizedScale	= 1.0f;
+	float previousError		= 0.0f;
+	float olderError		= 0.0f;
+};
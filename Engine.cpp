@@ -7,8 +7,10 @@
 #include "EntityManager.h"
 #include "Scene.h"
 #include "Model.h"
+#include "MeshCache.h"
 #include "stb_image.h"
 #include "Framebuffer.h"
+#include "GLState.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -16,10 +18,17 @@
 #include <glm/gtc/quaternion.hpp>
 #include <typeinfo>
 #include <filesystem>
+#include <fstream>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
 
 unsigned int Engine::SCREEN_WIDTH  = 1600;
 unsigned int Engine::SCREEN_HEIGHT = 900;
 bool		 Engine::FULLSCREEN	   = false;
+bool		 Engine::HEADLESS	   = false;
+int			 Engine::CONTEXT_CREATION_API = GLFW_NATIVE_CONTEXT_API;
+std::string	 Engine::CACHE_DIRECTORY = "cache";
 
 Engine::Engine()
 {
@@ -37,27 +46,88 @@ Engine& Engine::Instance()
 	return engine;
 }
 
-void Engine::Run()
+int Engine::Run()
 {
+	if (!initialized)
+		return int(ExitCode::INITIALIZATION_FAILED);
+
 	startTime = glfwGetTime();
 	SetupShaders();
 	OnStartEngine();
 
 	SetPostProcessing(true);
 
+	frameLimiter.SetTargetRate(frameRateLimit);
+
+	if (HEADLESS)
+	{
+		headlessTarget = std::make_unique<Framebuffer>(SCREEN_WIDTH, SCREEN_HEIGHT);
+		headlessTarget->Generate();
+	}
+
 	while (!glfwWindowShouldClose(window))
 	{
-		postProcessingShaders[ShaderType::CUSTOM_EFFECT].use();
-		postProcessingShaders[ShaderType::CUSTOM_EFFECT].setFloat("t", GetTimeSinceCreation());
+		if ((maxFrames > 0 && frameCount >= maxFrames) || (maxDuration > 0.0 && glfwGetTime() - startTime >= maxDuration))
+			break;
+
 		CalculateDeltaTime();
+		double frameStart = glfwGetTime();
+		frameStartTime = frameStart;
+		FinishModelLoads(false);
 		entityManager->update();
-		ProcessInput();
-		if (activeScene) activeScene->OnUpdate();
-		ExecuteActions();
-		TransformEntities();
+
+		if (FIXED_TIMESTEP)
+		{
+			double step = 1.0 / simulationRate;
+			simulationAccumulator += BENCHMARK ? step : frameTime;
+
+			unsigned int steps = 0;
+			while (simulationAccumulator >= step && steps < maxSimulationSteps)
+			{
+				deltaTime = step;
+				Simulate();
+				simulationAccumulator -= step;
+				++steps;
+			}
+			if (simulationAccumulator >= step)
+				simulationAccumulator = std::fmod(simulationAccumulator, step);
+
+			interpolationAlpha = float(simulationAccumulator / step);
+			frameStats.simulationSteps = steps;
+		}
+		else
+		{
+			deltaTime = frameTime;
+			Simulate();
+			interpolationAlpha = 1.0f;
+			frameStats.simulationSteps = 1;
+		}
+
 		DefaultShaderUpdate();
 		Render();
+		if (BENCHMARK)
+		{
+			benchmark.Record(frameCount, float((glfwGetTime() - frameStart) * 1000.0),
+				GPU_PROFILING ? gpuProfiler.GetLastTime("Frame") : 0.0f, frameStats.drawCalls, frameStats.triangles);
+		}
+		frameLimiter.Wait();
+		++frameCount;
 	}
+
+	if (GPU_PROFILING)
+	{
+		gpuProfiler.PrintReport(std::cout);
+		if (!gpuProfileCsvPath.empty())
+			gpuProfiler.WriteCsv(gpuProfileCsvPath);
+	}
+
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		std::cout << "ERROR::ENGINE::GL error 0x" << std::hex << error << std::dec << " after " << frameCount << " frames." << std::endl;
+		return int(ExitCode::GL_ERROR);
+	}
+	return int(ExitCode::SUCCESS);
 }
 
 // MAIN SYSTEMS
@@ -65,59 +135,109 @@ void Engine::Run()
 
 void Engine::CreateWindow()
 {
-	glfwInit();
+	if (!glfwInit())
+	{
+		std::cout << "Failed to initialize GLFW" << std::endl;
+		return;
+	}
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, CONTEXT_CREATION_API);
+	// A headless run still needs a window for its context, it just never shows it.
+	if (HEADLESS)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
-	window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Recap", FULLSCREEN ? glfwGetPrimaryMonitor() : NULL, NULL);
+	window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Recap", FULLSCREEN && !HEADLESS ? glfwGetPrimaryMonitor() : NULL, NULL);
 	if (!window)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
+		return;
 	}
 
 	// Make window the current context
 	glfwMakeContextCurrent(window);
 
 	// Disable the cursor.
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!HEADLESS)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	// Initialize GLAD.
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		glfwTerminate();
+		return;
 	}
+
+	initialized = true;
 }
 
 void Engine::SetupShaders()
 {
-	// Load all the shaders.
-	shaderMap[ShaderType::DEFAULT].load("shaders/vertexShader.vert", "shaders/fragmentShader.frag");
-	shaderMap[ShaderType::LIGHT_SOURCE].load("shaders/lightVertexShader.vert", "shaders/simpleColorFragmentShader.frag");
-	shaderMap[ShaderType::OUTLINE].load("shaders/lightVertexShader.vert", "shaders/simpleColorFragmentShader.frag");
-
-	postProcessingShaders[ShaderType::POST_PROCESSING_DEFAULT].load("shaders/ppQuad.vert", "shaders/ppDefault.frag");
-	postProcessingShaders[ShaderType::COLOR_INVERSION].load("shaders/ppQuad.vert", "shaders/ppInversion.frag");
-	postProcessingShaders[ShaderType::GRAYSCALE].load("shaders/ppQuad.vert", "shaders/ppGrayscale.frag");
-	postProcessingShaders[ShaderType::SHARPEN].load("shaders/ppQuad.vert", "shaders/ppSharpen.frag");
-	postProcessingShaders[ShaderType::BLUR].load("shaders/ppQuad.vert", "shaders/ppBlur.frag");
-	postProcessingShaders[ShaderType::EDGE_DETECTION].load("shaders/ppQuad.vert", "shaders/ppEdgeDetection.frag");
-	postProcessingShaders[ShaderType::CUSTOM_EFFECT].load("shaders/ppQuad.vert", "shaders/ppCustomEffect.frag");
+	// Shaders are compiled by GetShader() the first time they are needed.
+	shaderSources[ShaderType::DEFAULT] = { "shaders/vertexShader.vert", "shaders/fragmentShader.frag", TEXTURE_ARRAYS ? "#define TEXTURE_ARRAYS\n" : "", false };
+	shaderSources[ShaderType::LIGHT_SOURCE] = { "shaders/lightVertexShader.vert", "shaders/simpleColorFragmentShader.frag", "", false };
+	shaderSources[ShaderType::OUTLINE] = { "shaders/lightVertexShader.vert", "shaders/outlineMask.frag", "", false };
+	shaderSources[ShaderType::OUTLINE_EDGES] = { "shaders/ppQuad.vert", "shaders/outlineEdges.frag", "", false };
+	shaderSources[ShaderType::DEPTH_PREPASS] = { "shaders/depthPrepass.vert", "shaders/depthPrepass.frag", "", false };
+
+	shaderSources[ShaderType::POST_PROCESSING_DEFAULT] = { "shaders/ppQuad.vert", "shaders/ppDefault.frag", "", true };
+	shaderSources[ShaderType::COLOR_INVERSION] = { "shaders/ppQuad.vert", "shaders/ppInversion.frag", "", true };
+	shaderSources[ShaderType::GRAYSCALE] = { "shaders/ppQuad.vert", "shaders/ppGrayscale.frag", "", true };
+	shaderSources[ShaderType::SHARPEN] = { "shaders/ppQuad.vert", "shaders/ppSharpen.frag", "", true };
+	shaderSources[ShaderType::BLUR] = { "shaders/ppQuad.vert", "shaders/ppBlur.frag", "", true };
+	shaderSources[ShaderType::EDGE_DETECTION] = { "shaders/ppQuad.vert", "shaders/ppEdgeDetection.frag", "", true };
+	shaderSources[ShaderType::CUSTOM_EFFECT] = { "shaders/ppQuad.vert", "shaders/ppCustomEffect.frag", "", true };
+	shaderSources[ShaderType::UPSCALE] = { "shaders/ppQuad.vert", "shaders/ppUpscale.frag", "", true };
+
+	if (!LAZY_LOADING)
+	{
+		for (auto& pair : shaderSources)
+			GetShader(pair.first);
+	}
 
-	activeShader = shaderMap[ShaderType::DEFAULT];
-	activePostProcessingShader = postProcessingShaders[ShaderType::POST_PROCESSING_DEFAULT];
+	activeShader = GetShader(ShaderType::DEFAULT);
 
 	// Set some default values for the default shader.
 	activeShader.use();
 	activeShader.setFloat("material.shininess", 64.0f);
 	activeShader.setFloat("camInfo.near", nearFrustum);
 	activeShader.setFloat("camInfo.far", farFrustum);
+	if (TEXTURE_ARRAYS)
+	{
+		activeShader.bindUniformBlock("MaterialData", MaterialTable::MATERIAL_DATA_BINDING);
+		for (unsigned int i = 0; i < MaterialTable::MAX_TEXTURE_ARRAYS; ++i)
+		{
+			activeShader.setInt("materialArrays[" + std::to_string(i) + "]", MaterialTable::FIRST_TEXTURE_UNIT + i);
+		}
+	}
+}
+
+Shader& Engine::GetShader(ShaderType type)
+{
+	auto found = shaders.find(type);
+	if (found != shaders.end())
+		return *assets.Get(found->second);
+
+	const ShaderSource& source = shaderSources[type];
+	ShaderHandle handle = assets.LoadShader(source.vertexPath, source.fragmentPath, source.defines);
+	shaders[type] = handle;
+	Shader& shader = *assets.Get(handle);
+	// Per-frame and per-object data come from the streaming buffer.
+	shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	if (!source.postProcessing)
+		shader.bindUniformBlock("ObjectData", OBJECT_DATA_BINDING);
+	return shader;
 }
 
 void Engine::OnStartEngine()
 {
+	uploadQueue.Generate();
+	if (ASYNC_UPLOADS)
+		geometryArena.uploadQueue = &uploadQueue;
+
 	LoadModels();
 
 	if (WIREFRAME)
@@ -125,15 +245,19 @@ void Engine::OnStartEngine()
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	}
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_STENCIL_TEST);
-	glEnable(GL_CULL_FACE);
+	GLState::Instance().Enable(GL_DEPTH_TEST);
+	GLState::Instance().Enable(GL_CULL_FACE);
+
+	glGenQueries(2, fragmentQueries);
+	streamingBuffer.Generate();
 
 	SetBlending(BLEND);
 
 	// Add default scene.
-	sceneMap["defaultScene"] = std::make_shared<Scene>("defaultScene");
-	activeScene = sceneMap["defaultScene"];
+	if (!startScene)
+		startScene = std::make_shared<Scene>("defaultScene");
+	sceneMap[startScene->name] = startScene;
+	activeScene = startScene;
 
 	activeScene->BindActions();
 	activeScene->OnStartScene();
@@ -147,9 +271,12 @@ void Engine::LoadModels()
 {
 	// Load the default texture for textureless models.
 	TextureInfo info;
-	defaultTexture.load("textures/white.jpg", info);
-	defaultTexture.type = TextureType::DIFFUSE;
+	defaultTexture = textureCache.Load("textures/white.jpg", info);
+	// Queried on the context thread before workers cook textures, which reuse the result.
+	TextureCooker::IsS3tcSupported();
+	placeholderModel = assets.AddModel(Model::createBox("placeholder", glm::vec3(-0.5f), glm::vec3(0.5f)));
 
+	// Find one model file per folder.
 	std::string mainPath = "models/custom_models";
 	for (const auto& entry : std::filesystem::directory_iterator(mainPath))
 	{
@@ -163,7 +290,7 @@ void Engine::LoadModels()
 				std::string format = filePathStr.substr(filePathStr.find_last_of('.') + 1, filePathStr.size());
 				if (format == "blend" || format == "obj")
 				{
-					models[modelName] = std::make_shared<Model>(filePathStr, modelName);
+					modelFiles[modelName] = filePathStr;
 					break;
 				}
 			}
@@ -174,40 +301,203 @@ void Engine::LoadModels()
 		}
 	}
 
-	primitiveModels[Primitive::QUAD] = std::make_shared<Model>("models/primitives/quad.obj", "quad");
-	postProcessingQuadModel = std::make_shared<Model>("models/primitives/quad.obj", "quad");
+	if (!LAZY_LOADING)
+	{
+		double loadStart = glfwGetTime();
+		for (auto& pair : modelFiles)
+			GetModel(pair.first);
+		WaitForModels();
+		std::cout << modelFiles.size() << " models loaded in " << (glfwGetTime() - loadStart) * 1000.0 << " ms: " << coldModelLoads
+			<< " imported in " << coldModelLoadTime * 1000.0 << " ms and " << warmModelLoads << " read from the mesh cache in "
+			<< warmModelLoadTime * 1000.0 << " ms, summed over threads." << std::endl;
+	}
+
+	std::cout << textureCache.GetTextureCount() << " textures loaded, " << textureCache.GetPathHits() << " loads shared by path and "
+		<< textureCache.GetContentHits() << " by contents." << std::endl;
+
+	primitiveModels.resize(size_t(Primitive::QUAD) + 1);
+	primitiveModels[size_t(Primitive::QUAD)] = assets.AddModel(std::make_unique<Model>("models/primitives/quad.obj", "quad"));
+	// The post-processing vertex shader reads positions directly, they must not be quantized.
+	postProcessingQuadModel = assets.AddModel(std::make_unique<Model>("models/primitives/quad.obj", "quad", false, false));
+}
+
+ModelHandle Engine::GetModel(const std::string& name)
+{
+	ModelHandle found = assets.FindModel(name);
+	if (found.IsValid())
+		return found;
+
+	auto file = modelFiles.find(name);
+	if (file == modelFiles.end())
+	{
+		std::cout << "ERROR::ENGINE::No model named '" << name << "' in models/custom_models." << std::endl;
+		return placeholderModel;
+	}
+
+	bool useMaterialTable = TEXTURE_ARRAYS;
+	ModelHandle handle = assets.AddModel(std::make_unique<Model>("", name, useMaterialTable), name);
+	Model* model = assets.Get(handle);
+
+	std::string path = file->second;
+	if (!PARALLEL_MODEL_LOADING)
+	{
+		ModelLoad load;
+		load.model = handle;
+		double start = glfwGetTime();
+		load.prepared = model->prepare(path);
+		load.prepareTime = glfwGetTime() - start;
+		FinishModelLoad(load);
+		return handle;
+	}
+
+	// The model draws as its placeholder until the load is finished on this thread. The CPU phase runs on a staging
+	// model, so the one in use is never written to by the worker. A cached model already has its bounds, so the box
+	// and culling match the model's extent until it arrives.
+	glm::vec3 cachedMin, cachedMax;
+	if (MESH_CACHE && MeshCache::ReadBounds(MeshCache::GetCachePath(path), cachedMin, cachedMax))
+	{
+		model->ownedPlaceholder = Model::createBox(name + "_placeholder", cachedMin, cachedMax);
+		model->placeholder = model->ownedPlaceholder.get();
+	}
+	else
+		model->placeholder = assets.Get(placeholderModel);
+	model->boundsMin = model->placeholder->boundsMin;
+	model->boundsMax = model->placeholder->boundsMax;
+	++pendingModelLoads;
+	threadPool.Enqueue([this, handle, name, path, useMaterialTable]()
+	{
+		ModelLoad load;
+		load.model = handle;
+		load.staging = std::make_unique<Model>("", name, useMaterialTable);
+		double start = glfwGetTime();
+		try
+		{
+			load.prepared = load.staging->prepare(path);
+		}
+		catch (...)
+		{
+			std::cout << "ERROR::MODEL::NAME::" << name << "::Import failed." << std::endl;
+		}
+		load.prepareTime = glfwGetTime() - start;
+
+		std::lock_guard<std::mutex> lock(modelLoadMutex);
+		finishedModelLoads.push_back(std::move(load));
+		modelLoadFinished.notify_one();
+	});
+	return handle;
+}
+
+ModelHandle Engine::GetModel(Primitive primitive) const
+{
+	return size_t(primitive) < primitiveModels.size() ? primitiveModels[size_t(primitive)] : ModelHandle();
+}
+
+std::vector<std::string> Engine::GetModelNames() const
+{
+	std::vector<std::string> names;
+	for (auto& pair : modelFiles)
+		names.push_back(pair.first);
+	return names;
+}
+
+void Engine::UnloadModel(const std::string& name)
+{
+	// A load still running finds the handle stale and drops its result.
+	ModelHandle handle = assets.FindModel(name);
+	if (handle.IsValid())
+		assets.Unload(handle);
+}
+
+void Engine::WaitForModels()
+{
+	FinishModelLoads(true);
+}
+
+void Engine::FinishModelLoads(bool wait)
+{
+	while (pendingModelLoads > 0)
+	{
+		std::vector<ModelLoad> finished;
+		{
+			std::unique_lock<std::mutex> lock(modelLoadMutex);
+			if (wait)
+				modelLoadFinished.wait(lock, [this]() { return !finishedModelLoads.empty(); });
+			finished.swap(finishedModelLoads);
+		}
+
+		for (ModelLoad& load : finished)
+		{
+			--pendingModelLoads;
+			FinishModelLoad(load);
+		}
+		if (!wait)
+			return;
+	}
+}
+
+void Engine::FinishModelLoad(ModelLoad& load)
+{
+	Model* model = assets.Get(load.model);
+	if (!model)
+		return;
+
+	if (!load.prepared)
+	{
+		// The model stays empty, so nothing draws in its place.
+		model->placeholder = nullptr;
+		model->ownedPlaceholder.reset();
+		model->boundsMin = model->boundsMax = glm::vec3(0.0f);
+		std::cout << "ERROR::ENGINE::The model '" << model->name << "' could not be loaded." << std::endl;
+		return;
+	}
+
+	double uploadStart = glfwGetTime();
+	if (load.staging)
+		model->adopt(*load.staging);
+	model->upload();
+	double uploadTime = glfwGetTime() - uploadStart;
+
+	bool warm = model->fromMeshCache;
+	(warm ? warmModelLoadTime : coldModelLoadTime) += load.prepareTime + uploadTime;
+	++(warm ? warmModelLoads : coldModelLoads);
+	std::cout << "The model '" << model->name << "' was " << (warm ? "read from the mesh cache" : "imported") << " in "
+		<< load.prepareTime * 1000.0 << " ms on the CPU and " << uploadTime * 1000.0 << " ms on the GL thread." << std::endl;
 }
 
 void Engine::DefaultShaderUpdate()
 {
-	activeShader = shaderMap[ShaderType::DEFAULT];
+	activeShader = GetShader(ShaderType::DEFAULT);
 	activeShader.use();
 
-	CalculateViewMatrix(activeShader);
-	CalculateProjectionMatrix(activeShader);
+	CalculateViewMatrix();
+	CalculateProjectionMatrix();
 	CalculateLighting(activeShader);
 }
 
-void Engine::CalculateViewMatrix(Shader& shader)
+void Engine::CalculateViewMatrix()
 {
 	if (mainCamera)
 	{
 		cTransform cameraTransform = entityManager->getEntityWithID(mainCamera->ownerID)->getComponent<cTransform>();
-		glm::vec3 cameraPosition = cameraTransform.position + mainCamera->relativePosition;
-		view = glm::lookAt(cameraPosition, cameraPosition + cameraTransform.front, cameraTransform.up);
+		glm::vec3 cameraPosition = glm::mix(cameraTransform.previousPosition, cameraTransform.position, interpolationAlpha) + mainCamera->relativePosition;
+		// Mouse look changes the orientation between steps, so the direction is not interpolated to keep it responsive.
+		glm::vec3 front = cameraTransform.front, up = cameraTransform.up;
+		if (cameraTransform.allowRotation)
+		{
+			front = glm::normalize(glm::rotate(glm::inverse(cameraTransform.orientation), glm::vec3(0.0, 0.0, -1.0)));
+			up = glm::normalize(glm::rotate(glm::inverse(cameraTransform.orientation), glm::vec3(0.0, 1.0, 0.0)));
+		}
+		view = glm::lookAt(cameraPosition, cameraPosition + front, up);
 	}
 	else
 	{
 		view = glm::translate(view, glm::vec3(0.0f, 0.0f, 5.0f));
 	}
-
-	shader.setFMat4("view", view);
 }
 
-void Engine::CalculateProjectionMatrix(Shader& shader)
+void Engine::CalculateProjectionMatrix()
 {
 	projection = glm::perspective(glm::radians(FOV), (float)SCREEN_WIDTH / SCREEN_HEIGHT, nearFrustum, farFrustum);
-	shader.setFMat4("projection", projection);
 }
 
 void Engine::CalculateLighting(Shader& shader)
@@ -271,146 +561,479 @@ void Engine::CalculatePointLights(Shader& shader)
 
 void Engine::Render()
 {
-	if (POST_PROCESSING)
+	if (GPU_PROFILING)
+		gpuProfiler.BeginFrame();
+	BeginGpuPass("Frame");
+
+	BeginGpuPass("Upload");
+	uploadQueue.Process(uploadBudget);
+	textureCache.CollectReleased();
+	EndGpuPass();
+	frameStats.uploadedBytes = uploadQueue.GetUploadedBytes();
+	frameStats.pendingUploadBytes = uploadQueue.GetPendingBytes();
+
+	UploadTransientData();
+
+	if (OCCLUSION_CULLING)
+		CullEntities();
+
+	if (TEXTURE_ARRAYS)
 	{
-		// Bind custom framebuffer.
-		framebuffers[FramebufferType::POST_PROCESSING]->Bind();
-		glEnable(GL_DEPTH_TEST);
+		// Models loaded since the last frame added materials. The arrays are repacked before anything draws with them.
+		if (materialTable.NeedsBuild())
+			materialTable.Build(threadPool);
+		materialTable.Bind();
 	}
 
-	if (!BLEND)
-		NormalRender();
-	else
-		BlendRender();
-
-	if (POST_PROCESSING)
-	{
-		// Go back to default buffer.
-		framebuffers[FramebufferType::POST_PROCESSING]->Unbind();
-		// Clear color and depth buffer. Clearing stencil buffer causes problems with outlining.
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// Apply the framebuffer's color buffer as a texture to the quad model.
-		postProcessingQuadModel->ApplyTexture(framebuffers[FramebufferType::POST_PROCESSING]->GetColorBuffer());
-		DrawEntity(*postProcessingQuad);
-		glfwSwapBuffers(window);
+	int windowWidth = int(SCREEN_WIDTH), windowHeight = int(SCREEN_HEIGHT);
+	if (!HEADLESS)
+		glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+
+	float resolutionScale = 1.0f;
+	if (DYNAMIC_RESOLUTION)
+	{
+		// frameTime includes the pacing waits, with a frame rate cap or vsync at the target it would always read as a miss.
+		float measured = GPU_PROFILING ? gpuProfiler.GetLastTime("Frame") : float(frameWorkTime * 1000.0);
+		resolutionScale = dynamicResolution.Update(measured);
 	}
+	frameStats.resolutionScale = resolutionScale;
+	renderWidth = std::max(1u, (unsigned int)(SCREEN_WIDTH * resolutionScale));
+	renderHeight = std::max(1u, (unsigned int)(SCREEN_HEIGHT * resolutionScale));
+	bool upscale = resolutionScale < 1.0f;
+
+	renderGraph.Reset();
+	RenderResource backbuffer = renderGraph.ImportBackbuffer("Backbuffer", windowWidth, windowHeight, headlessTarget.get());
+	RenderResource sceneColor = backbuffer;
+	if (POST_PROCESSING || upscale)
+		sceneColor = renderGraph.CreateTarget("SceneColor", renderWidth, renderHeight, true);
+
+	renderGraph.AddPass("Forward", {}, sceneColor, [this](const RenderGraph&)
+	{
+		GLState::Instance().Enable(GL_DEPTH_TEST);
+		if (!BLEND)
+			NormalRender();
+		else
+			BlendRender();
+	});
+
+	if (!outlinedObjects.empty())
+	{
+		// Outlined entities are drawn like any other, then marked in a mask from which one full screen pass draws
+		// the outlines of all of them.
+		RenderResource outlineMask = renderGraph.CreateTarget("OutlineMask", renderGraph.GetWidth(sceneColor),
+			renderGraph.GetHeight(sceneColor), true);
+		renderGraph.AddPass("OutlineMask", {}, outlineMask, [this](const RenderGraph&)
+		{
+			DrawOutlineMask();
+		});
+		renderGraph.AddPass("Outline", { outlineMask }, sceneColor, [this, outlineMask](const RenderGraph& graph)
+		{
+			DrawOutlineEdges(graph, outlineMask);
+		});
+	}
+
+	if (POST_PROCESSING || upscale)
+	{
+		// Effects run at the scene's resolution, and a reduced one is brought back to the screen's by the final copy.
+		const PostProcessChain noEffects;
+		const PostProcessChain& chain = POST_PROCESSING ? postProcessChain : noEffects;
+		Shader& copyShader = GetShader(upscale ? ShaderType::UPSCALE : ShaderType::POST_PROCESSING_DEFAULT);
+		if (upscale)
+		{
+			copyShader.use();
+			copyShader.setFloat("sharpness", upscaleSharpness);
+		}
+		chain.AddToGraph(renderGraph, sceneColor, backbuffer, *assets.Get(postProcessingQuadModel), copyShader);
+	}
+
+	renderGraph.Execute(GPU_PROFILING ? &gpuProfiler : nullptr);
+
+	EndGpuPass();
+	if (GPU_PROFILING)
+		gpuProfiler.EndFrame();
+
+	frameWorkTime = glfwGetTime() - frameStartTime;
+	glfwPollEvents();
+	if (!HEADLESS)
+		glfwSwapBuffers(window);
+
+	streamingBuffer.EndFrame();
+	assets.EndFrame();
+
+	GLState::Instance().EndFrame();
+	frameStats.glCallsIssued = GLState::Instance().GetIssuedCalls();
+	frameStats.glCallsFiltered = GLState::Instance().GetFilteredCalls();
+	frameStats.drawCalls = GLState::Instance().GetDrawCalls();
+	frameStats.triangles = GLState::Instance().GetTriangles();
 }
 
-void Engine::NormalRender()
+void Engine::UploadTransientData()
 {
-	ClearScreen(0.1f, 0.1f, 0.1f, 1.0f);
+	// Every drawable entity writes its ObjectData, the regions grow to fit them all.
+	size_t drawableEntities = 0;
+	for (Entity& e : entityManager->getEntities())
+	{
+		if (e.hasComponent<cModel>() && e.hasComponent<cTransform>())
+			++drawableEntities;
+	}
+	streamingBuffer.Reserve(streamingBuffer.GetAlignedSize(sizeof(FrameData)) + drawableEntities * streamingBuffer.GetAlignedSize(sizeof(ObjectData)));
+	streamingBuffer.BeginFrame();
+
+	FrameData frameData;
+	frameData.view = view;
+	frameData.projection = projection;
+	frameData.timeParams = glm::vec4(float(GetTimeSinceCreation()), 0.0f, 0.0f, 0.0f);
+	GLintptr frameOffset = streamingBuffer.Write(&frameData, sizeof(FrameData));
 
+	for (unsigned int& count : frameStats.entitiesPerLod)
+		count = 0;
+
+	unsigned int overflowedEntities = 0;
+	// Write the matrices of every drawable entity once, draws then only bind a range.
 	for (Entity& e : entityManager->getEntities())
 	{
-		if (e.hasComponent<cModel>() && !e.getComponent<cModel>().isOutlined
-			&& e.hasComponent<cTransform>() && !e.hasComponent<cCamera>())
+		if (!e.hasComponent<cModel>() || !e.hasComponent<cTransform>())
+			continue;
+		const Model* model = assets.Get(e.getComponent<cModel>().model);
+		if (!model)
+			continue;
+
+		if (e.getID() >= objectDataOffsets.size())
 		{
-			DrawEntity(e);
+			objectDataOffsets.resize(e.getID() + 1, -1);
 		}
+
+		// Quantized models store positions in a unit box, the dequantization is folded into the model matrix.
+		const glm::mat4& dequantization = model->dequantization;
+
+		ObjectData objectData;
+		objectData.model = CalculateModelMatrix(e);
+		objectData.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(view * objectData.model))));
+		SelectLod(e.getComponent<cModel>(), *model, objectData.model);
+		objectData.model = objectData.model * dequantization;
+		objectDataOffsets[e.getID()] = streamingBuffer.Write(&objectData, sizeof(ObjectData));
+		if (objectDataOffsets[e.getID()] < 0)
+			++overflowedEntities;
 	}
 
-	for (Entity& e : outlinedObjects)
+	streamingBuffer.Flush();
+
+	if (overflowedEntities > 0)
+		std::cout << "ERROR::STREAMING_BUFFER::Frame region is full, " << overflowedEntities << " entities are not drawn." << std::endl;
+	if (frameOffset < 0)
+		std::cout << "ERROR::STREAMING_BUFFER::Frame region is full." << std::endl;
+	else
+		GLState::Instance().BindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, streamingBuffer.GetID(), frameOffset, sizeof(FrameData));
+
+	frameStats.streamingStalls = streamingBuffer.GetStallCount();
+}
+
+float Engine::CalculateScreenSize(const Model& model, const glm::mat4& modelMatrix) const
+{
+	float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	float radius = 0.5f * glm::length(model.boundsMax - model.boundsMin) * scale;
+	glm::vec3 center = glm::vec3(view * modelMatrix * glm::vec4(0.5f * (model.boundsMin + model.boundsMax), 1.0f));
+	return radius * projection[1][1] / glm::max(glm::length(center), 0.0001f);
+}
+
+void Engine::SelectLod(cModel& entityModel, const Model& model, const glm::mat4& modelMatrix)
+{
+	unsigned int lod = std::min(entityModel.lod, model.lodCount - 1);
+
+	if (model.lodCount > 1)
 	{
-		if (e.hasComponent<cTransform>() && !e.hasComponent<cCamera>())
+		float screenSize = CalculateScreenSize(model, modelMatrix);
+		while (lod + 1 < model.lodCount && screenSize < lodScreenSizes[lod] * (1.0f - lodHysteresis))
+			++lod;
+		while (lod > 0 && screenSize > lodScreenSizes[lod - 1] * (1.0f + lodHysteresis))
+			--lod;
+	}
+
+	entityModel.lod = lod;
+	++frameStats.entitiesPerLod[lod];
+}
+
+void Engine::CullEntities()
+{
+	occlusionCuller.BeginFrame(projection * view);
+
+	// Large opaque models close to the camera occlude, every drawable entity is tested.
+	culledEntities.clear();
+	for (Entity& e : entityManager->getEntities())
+	{
+		if (!e.hasComponent<cModel>() || !e.hasComponent<cTransform>() || e.hasComponent<cCamera>())
+			continue;
+
+		const Model* entityModel = assets.Get(e.getComponent<cModel>().model);
+		if (!entityModel)
+			continue;
+		const Model& model = *entityModel;
+		glm::mat4 modelMatrix = CalculateModelMatrix(e);
+		culledEntities.push_back({ &e, occlusionCuller.AddOccludee(modelMatrix, model.boundsMin, model.boundsMax) });
+
+		bool blended = BLEND && model.isTransparent;
+		if (!model.occluderIndices.empty() && !blended && CalculateScreenSize(model, modelMatrix) >= occluderScreenSize)
+			occlusionCuller.AddOccluder(modelMatrix, model.occluderPositions, model.occluderIndices);
+	}
+
+	occlusionCuller.Cull(threadPool);
+
+	frameStats.entitiesVisible = frameStats.entitiesOccluded = frameStats.entitiesOutsideView = 0;
+	for (const auto& entry : culledEntities)
+	{
+		OcclusionCuller::Result result = occlusionCuller.GetResult(entry.second);
+		entry.first->getComponent<cModel>().isVisible = result == OcclusionCuller::Result::VISIBLE;
+		switch (result)
 		{
-			glStencilMask(0xFF);
-			glStencilFunc(GL_ALWAYS, 1, 0xFF);
-			DrawEntity(e);
-			DrawOutlinedModel(e, e.getComponent<cModel>());
+		case OcclusionCuller::Result::VISIBLE:			++frameStats.entitiesVisible; break;
+		case OcclusionCuller::Result::OCCLUDED:			++frameStats.entitiesOccluded; break;
+		case OcclusionCuller::Result::OUTSIDE_FRUSTUM:	++frameStats.entitiesOutsideView; break;
 		}
 	}
+	frameStats.occluderTriangles = occlusionCuller.GetOccluderTriangleCount();
+}
 
-	glfwPollEvents();
-	if (!POST_PROCESSING)
-		glfwSwapBuffers(window);
+void Engine::BeginGpuPass(const char* name)
+{
+	if (GPU_PROFILING)
+		gpuProfiler.BeginPass(name);
+}
+
+void Engine::EndGpuPass()
+{
+	if (GPU_PROFILING)
+		gpuProfiler.EndPass();
+}
+
+bool Engine::BindObjectData(GLintptr offset)
+{
+	// Entities that did not fit into the streaming buffer would draw with the previous entity's matrices.
+	if (offset < 0)
+		return false;
+	GLState::Instance().BindBufferRange(GL_UNIFORM_BUFFER, OBJECT_DATA_BINDING, streamingBuffer.GetID(), offset, sizeof(ObjectData));
+	return true;
+}
+
+void Engine::NormalRender()
+{
+	ClearScreen(0.1f, 0.1f, 0.1f, 1.0f);
+
+	if (DEPTH_PREPASS)
+	{
+		BeginGpuPass("DepthPrepass");
+		DepthPrepass();
+		EndGpuPass();
+	}
+
+	BeginGpuPass("Scene");
+	BeginFragmentCounter();
+
+	DrawOpaqueEntities(false);
+
+	EndGpuPass();
+
+	EndFragmentCounter();
 }
 
-//  Currently outlining and blending work very weirdly together.
-//  Don't outline a transparent object.
+//  Transparent draws are collected into a per-frame queue and radix sorted, so the blend path allocates nothing.
 void Engine::BlendRender()
 {
 	ClearScreen(0.1f, 0.1f, 0.1f, 0.1f);
 
-	blendMap.clear();
+	transparentQueue.Clear();
 
-	for (Entity& e : entityManager->getEntities())
+	EntityVector& entities = entityManager->getEntities();
+	for (uint32_t i = 0; i < entities.size(); ++i)
 	{
+		Entity& e = entities[i];
 		if (e.hasComponent<cModel>() && e.hasComponent<cTransform>() && !e.hasComponent<cCamera>())
 		{
-			// Sort transparent objects based on proximity to main camera.
-			// Blending and outlining do not work well together.
-			if (e.getComponent<cModel>().model->isTransparent && mainCamera && !e.getComponent<cModel>().isOutlined)
-			{
-				float distance = glm::distance(
-					GetMainCameraOwner()->getComponent<cTransform>().position, 
-					e.getComponent<cTransform>().position
-				);
-				blendMap[distance] = &e;
-			}
+			const Model* model = assets.Get(e.getComponent<cModel>().model);
+			if (model && model->isTransparent)
+				QueueTransparentEntity(e, i);
+		}
+	}
 
-			// Draw only non-outlined and non-transparent objects first.
-			if (!e.getComponent<cModel>().isOutlined && !e.getComponent<cModel>().model->isTransparent)
-			{
-				DrawEntity(e);
-			}
+	// Sort transparent objects back to front in view space.
+	transparentQueue.Sort();
+
+	if (DEPTH_PREPASS)
+	{
+		BeginGpuPass("DepthPrepass");
+		DepthPrepass();
+		EndGpuPass();
+	}
+
+	BeginGpuPass("Scene");
+	BeginFragmentCounter();
+
+	// Draw only non-transparent objects first.
+	DrawOpaqueEntities(true);
+
+	EndGpuPass();
+
+	BeginGpuPass("Transparent");
+	for (const TransparentItem& item : transparentQueue.GetItems())
+	{
+		DrawEntity(entities[item.entityIndex], item.meshIndex);
+	}
+	EndGpuPass();
+
+	EndFragmentCounter();
+}
+
+void Engine::QueueTransparentEntity(Entity& e, uint32_t entityIndex)
+{
+	if (!e.getComponent<cModel>().isVisible)
+		return;
+
+	glm::mat4 modelView = view * CalculateModelMatrix(e);
+	const Model& model = *assets.Get(e.getComponent<cModel>().model);
+
+	if (transparencySortMode == TransparencySortMode::PER_MESH)
+	{
+		const std::vector<Mesh>& meshes = model.getMeshes();
+		for (uint32_t i = 0; i < meshes.size(); ++i)
+		{
+			glm::vec3 center = 0.5f * (meshes[i].boundsMin + meshes[i].boundsMax);
+			transparentQueue.Push(-(modelView * glm::vec4(center, 1.0f)).z, entityIndex, i);
 		}
 	}
+	else
+	{
+		glm::vec3 center = 0.5f * (model.boundsMin + model.boundsMax);
+		transparentQueue.Push(-(modelView * glm::vec4(center, 1.0f)).z, entityIndex);
+	}
+}
 
-	for (Entity& e : outlinedObjects)
+void Engine::DepthPrepass()
+{
+	// Lay down depth for opaque geometry with a minimal shader so that the lighting pass shades each pixel once.
+	Shader& depthShader = GetShader(ShaderType::DEPTH_PREPASS);
+	depthShader.use();
+
+	GLState::Instance().ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	for (Entity& e : entityManager->getEntities())
 	{
-		if (e.hasComponent<cTransform>() && !e.hasComponent<cCamera>())
+		if (IsDepthPrepassCandidate(e))
 		{
-			glStencilMask(0xFF);
-			glStencilFunc(GL_ALWAYS, 1, 0xFF);
+			if (!BindObjectData(objectDataOffsets[e.getID()]))
+				continue;
+
+			cModel& entityModel = e.getComponent<cModel>();
+			Model* model = assets.Get(entityModel.model);
+			GLState::Instance().SetEnabled(GL_CULL_FACE, model->isCullable);
+			model->DrawDepth(entityModel.lod);
+		}
+	}
+	GLState::Instance().ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void Engine::DrawOpaqueEntities(bool skipTransparent)
+{
+	if (DEPTH_PREPASS)
+	{
+		// Depth is already resolved, only the front-most fragment passes.
+		GLState::Instance().DepthFunc(GL_LEQUAL);
+		GLState::Instance().DepthMask(GL_FALSE);
+	}
+
+	for (Entity& e : entityManager->getEntities())
+	{
+		if (e.hasComponent<cModel>() && e.hasComponent<cTransform>() && !e.hasComponent<cCamera>())
+		{
+			const Model* model = assets.Get(e.getComponent<cModel>().model);
+			if (!model || (skipTransparent && model->isTransparent))
+				continue;
+
+			// Entities that were not in the pre-pass still have to write their own depth.
+			bool writesDepth = DEPTH_PREPASS && !IsDepthPrepassCandidate(e);
+			if (writesDepth)
+				GLState::Instance().DepthMask(GL_TRUE);
 			DrawEntity(e);
-			DrawOutlinedModel(e, e.getComponent<cModel>());
+			if (writesDepth)
+				GLState::Instance().DepthMask(GL_FALSE);
 		}
 	}
 
-	for (BlendMap::reverse_iterator it = blendMap.rbegin(); it != blendMap.rend(); ++it)
+	if (DEPTH_PREPASS)
 	{
-			DrawEntity(*(it->second));
+		GLState::Instance().DepthFunc(GL_LESS);
+		GLState::Instance().DepthMask(GL_TRUE);
 	}
+}
 
-	glfwPollEvents();
-	if (!POST_PROCESSING)
-		glfwSwapBuffers(window);
+bool Engine::IsDepthPrepassCandidate(Entity& e)
+{
+	// Custom shaders may transform vertices differently, so only default-shaded opaque models take part.
+	if (!e.hasComponent<cModel>() || !e.hasComponent<cTransform>() || e.hasComponent<cCamera>() || e.hasComponent<cShader>())
+		return false;
+	const Model* model = assets.Get(e.getComponent<cModel>().model);
+	return model && !model->isTransparent && e.getComponent<cModel>().isVisible;
 }
 
-void Engine::DrawEntity(Entity e)
+void Engine::BeginFragmentCounter()
 {
+	glBeginQuery(GL_SAMPLES_PASSED, fragmentQueries[fragmentQueryFrame % 2]);
+}
+
+void Engine::EndFragmentCounter()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	++fragmentQueryFrame;
+
+	// Read the query issued in the previous frame, if the GPU is done with it.
+	if (fragmentQueryFrame < 2)
+		return;
+	unsigned int previousQuery = fragmentQueries[fragmentQueryFrame % 2];
+	GLuint available = 0;
+	glGetQueryObjectuiv(previousQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available)
+	{
+		GLuint64 samples = 0;
+		glGetQueryObjectui64v(previousQuery, GL_QUERY_RESULT, &samples);
+		frameStats.fragmentsShaded = samples;
+		frameStats.overdraw = float(samples) / (float(renderWidth) * float(renderHeight));
+	}
+}
+
+glm::mat4 Engine::CalculateModelMatrix(Entity& e, float scaleFactor)
+{
+	cTransform& transform = e.getComponent<cTransform>();
+	glm::vec3 position = glm::mix(transform.previousPosition, transform.position, interpolationAlpha);
+	glm::quat orientation = glm::slerp(transform.previousOrientation, transform.orientation, interpolationAlpha);
+	glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), position);
+	glm::mat4 scaleMatrix = glm::scale(glm::mat4(1.0f), scaleFactor * transform.scale);
+	glm::mat4 rotationMatrix = glm::toMat4(orientation);
+	return translationMatrix * rotationMatrix * scaleMatrix;
+}
+
+void Engine::DrawEntity(Entity& e, uint32_t meshIndex)
+{
+	cModel& entityModel = e.getComponent<cModel>();
+	Model* model = assets.Get(entityModel.model);
+	if (!model || !entityModel.isVisible)
+		return;
+	if (e.hasComponent<cTransform>() && !BindObjectData(objectDataOffsets[e.getID()]))
+		return;
+
 	// This should not be handled here.
 	if (!(e.hasComponent<cShader>()))
 	{
-		activeShader = shaderMap[ShaderType::DEFAULT];
+		activeShader = GetShader(ShaderType::DEFAULT);
 		activeShader.use();
 	}
 	else
 	{
 		activeShader = e.getComponent<cShader>().shader;
 		activeShader.use();
-		activeShader.setFMat4("view", view);
-		activeShader.setFMat4("projection", projection);
 	}
 
-	glm::mat4 translationMatrix = glm::mat4(1.0f);
-	translationMatrix = glm::translate(translationMatrix, e.getComponent<cTransform>().position);
-	glm::mat4 scaleMatrix = glm::mat4(1.0f);
-	scaleMatrix = glm::scale(scaleMatrix, e.getComponent<cTransform>().scale);
-	glm::mat4 rotationMatrix = glm::toMat4(e.getComponent<cTransform>().orientation);
-	glm::mat4 model = translationMatrix * rotationMatrix * scaleMatrix;
-	activeShader.setFMat4("model", model);
-
-	// Calculate the normal matrix
-	glm::mat3 normal = glm::transpose(glm::inverse(view * model));
-	activeShader.setFMat3("normalMatrix", normal);
-
-	cModel& entityModel = e.getComponent<cModel>();
-	if (!entityModel.model->isCullable)
-		glDisable(GL_CULL_FACE);
-	entityModel.model->Draw(activeShader);
-	glEnable(GL_CULL_FACE);
+	GLState::Instance().SetEnabled(GL_CULL_FACE, model->isCullable);
+	if (meshIndex == TransparentQueue::ALL_MESHES)
+		model->Draw(activeShader, entityModel.lod);
+	else
+		model->DrawMesh(activeShader, meshIndex, entityModel.lod);
 }
 
 void Engine::ProcessInput()
@@ -471,6 +1094,47 @@ void Engine::ExecuteActions(Entity& e)
 	}
 }
 
+void Engine::Simulate()
+{
+	SaveSimulationState();
+	ProcessInput();
+	if (activeScene) activeScene->OnUpdate();
+	ExecuteActions();
+	FollowCameraPath();
+	TransformEntities();
+	simulationTime += deltaTime;
+}
+
+void Engine::FollowCameraPath()
+{
+	if (cameraPath.IsEmpty() || !mainCamera)
+		return;
+
+	CameraKeyframe keyframe = cameraPath.Evaluate(float(simulationTime));
+	cTransform& transform = GetMainCameraOwner()->getComponent<cTransform>();
+	transform.position = keyframe.position;
+	transform.velocity = glm::vec3(0.0f);
+	mainCamera->yaw = keyframe.yaw;
+	mainCamera->pitch = keyframe.pitch;
+	// Same construction as mouse look.
+	glm::quat qPitch = glm::angleAxis(glm::radians(-keyframe.pitch), glm::vec3(1, 0, 0));
+	glm::quat qYaw = glm::angleAxis(glm::radians(keyframe.yaw), glm::vec3(0, 1, 0));
+	transform.orientation = glm::normalize(qPitch * qYaw);
+}
+
+void Engine::SaveSimulationState()
+{
+	for (Entity& e : entityManager->getEntities())
+	{
+		if (e.hasComponent<cTransform>())
+		{
+			cTransform& transform = e.getComponent<cTransform>();
+			transform.previousPosition = transform.position;
+			transform.previousOrientation = transform.orientation;
+		}
+	}
+}
+
 void Engine::TransformEntities()
 {
 	for (Entity& e : entityManager->getEntities())
@@ -593,12 +1257,14 @@ void Engine::BindInputKey(unsigned int key, ActionType action)
 
 void Engine::BindCursorPositionCallback(GLFWcursorposfun MouseCallback)
 {
-	glfwSetCursorPosCallback(window, *MouseCallback);
+	if (window)
+		glfwSetCursorPosCallback(window, *MouseCallback);
 }
 
 void Engine::BindFramebufferSizeCallback(GLFWframebuffersizefun FrameBufferSizeCallback)
 {
-	glfwSetFramebufferSizeCallback(window, *FrameBufferSizeCallback);
+	if (window)
+		glfwSetFramebufferSizeCallback(window, *FrameBufferSizeCallback);
 }
 
 GLFWwindow* Engine::GetWindow() const
@@ -609,17 +1275,14 @@ GLFWwindow* Engine::GetWindow() const
 void Engine::CalculateDeltaTime()
 {
 	double currentFrame = glfwGetTime();
-	deltaTime = currentFrame - currentTime;
+	frameTime = currentFrame - currentTime;
 	currentTime = currentFrame;
 }
 
 void Engine::ClearScreen(float r, float g, float b, float a)
 {
-	glClearColor(r, g, b, a);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-	glStencilMask(0x00);
-	glStencilFunc(GL_ALWAYS, 1, 0xFF);
+	GLState::Instance().ClearColor(r, g, b, a);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 glm::vec3 Engine::TransformPositionVectorToViewSpace(const glm::vec3& v)
@@ -634,31 +1297,45 @@ glm::vec3 Engine::TransformDirectionalVectorToViewSpace(const glm::vec3& v)
 	return glm::vec3(dir4.x, dir4.y, dir4.z);
 }
 
-void Engine::DrawOutlinedModel(Entity e, cModel& model)
+void Engine::DrawOutlineMask()
 {
-	Shader previousShader = activeShader;
-	activeShader = shaderMap[ShaderType::OUTLINE];
-	glm::mat4 translationMatrix = glm::mat4(1.0f);
-	translationMatrix = glm::translate(translationMatrix, e.getComponent<cTransform>().position);
-	glm::mat4 scaleMatrix = glm::mat4(1.0f);
-	scaleMatrix = glm::scale(scaleMatrix, 1.1f * e.getComponent<cTransform>().scale);
-	glm::mat4 rotationMatrix = glm::toMat4(e.getComponent<cTransform>().orientation);
-	glm::mat4 modelMatrix = translationMatrix * rotationMatrix * scaleMatrix;
-	activeShader.use();
-	activeShader.setFMat4("model", modelMatrix);
-	activeShader.setFVec3("color", model.outlineColor);
-	activeShader.setFMat4("view", view);
-	activeShader.setFMat4("projection", projection);
-
-	glStencilMask(0x00);
-	glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-	glDisable(GL_DEPTH_TEST);
-	model.model->Draw(activeShader);
-	activeShader = previousShader;
-	activeShader.use();
-	glStencilMask(0xFF);
-	glStencilFunc(GL_ALWAYS, 1, 0xFF);
-	glEnable(GL_DEPTH_TEST);
+	GLState::Instance().Enable(GL_DEPTH_TEST);
+	GLState::Instance().ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	Shader& maskShader = GetShader(ShaderType::OUTLINE);
+	maskShader.use();
+	for (unsigned int i = 0; i < outlinedObjects.size(); ++i)
+	{
+		Entity& e = outlinedObjects[i];
+		cModel& model = e.getComponent<cModel>();
+		Model* outlinedModel = assets.Get(model.model);
+		if (!outlinedModel || !model.isVisible || e.hasComponent<cCamera>())
+			continue;
+
+		if (!BindObjectData(objectDataOffsets[e.getID()]))
+			continue;
+		maskShader.setFloat("objectId", float(std::min(i + 1, MAX_OUTLINE_COLORS)));
+		GLState::Instance().SetEnabled(GL_CULL_FACE, outlinedModel->isCullable);
+		outlinedModel->DrawGeometry(model.lod);
+	}
+}
+
+void Engine::DrawOutlineEdges(const RenderGraph& graph, RenderResource mask)
+{
+	Shader& edgeShader = GetShader(ShaderType::OUTLINE_EDGES);
+	edgeShader.use();
+	edgeShader.setInt("outlineMask", 0);
+	edgeShader.setInt("outlineWidth", outlineWidth);
+	unsigned int colors = std::min((unsigned int)outlinedObjects.size(), MAX_OUTLINE_COLORS);
+	for (unsigned int i = 0; i < colors; ++i)
+		edgeShader.setFVec3("outlineColors[" + std::to_string(i) + "]", outlinedObjects[i].getComponent<cModel>().outlineColor);
+	GLState::Instance().BindTexture(0, GL_TEXTURE_2D, graph.GetTexture(mask));
+
+	// Outlines are drawn over everything, including whatever hides the entity.
+	GLState::Instance().Disable(GL_DEPTH_TEST);
+	assets.Get(postProcessingQuadModel)->DrawGeometry(0);
+	GLState::Instance().Enable(GL_DEPTH_TEST);
 }
 
 void Engine::OutlineEntity(Entity e, glm::vec3 color)
@@ -691,29 +1368,21 @@ void Engine::SetBlending(bool blend, GLenum sourceFactor, GLenum destinationFact
 	BLEND = blend;
 	if (blend)
 	{
-		glEnable(GL_BLEND);
-		glBlendFunc(sourceFactor, destinationFactor);
+		GLState::Instance().Enable(GL_BLEND);
+		GLState::Instance().BlendFunc(sourceFactor, destinationFactor);
 	}
 	else
-		glDisable(GL_BLEND);
+		GLState::Instance().Disable(GL_BLEND);
 }
 
 void Engine::SetPostProcessing(bool postProcessing)
 {
-	if (postProcessing && !POST_PROCESSING)
-		EnablePostProcessing();
-
 	POST_PROCESSING = postProcessing;
 }
 
-void Engine::EnablePostProcessing()
+void Engine::SetDepthPrepass(bool depthPrepass)
 {
-	framebuffers[FramebufferType::POST_PROCESSING] = std::make_shared<Framebuffer>(SCREEN_WIDTH, SCREEN_HEIGHT);
-	framebuffers[FramebufferType::POST_PROCESSING]->Generate();
-	Entity ppq = AddEntity("post_processing_quad");
-	ppq.addComponent<cModel>(postProcessingQuadModel);
-	ppq.addComponent<cShader>(activePostProcessingShader);
-	postProcessingQuad = std::make_unique<Entity>(ppq);
+	DEPTH_PREPASS = depthPrepass;
 }
 
 
@@ -724,27 +1393,41 @@ double Engine::GetTimeSinceCreation() const
 	return currentTime;
 }
 
-Engine::~Engine()
+std::string Engine::GetCachePath(const std::string& sourcePath, const std::string& extension)
 {
-	for (auto& pair : shaderMap)
-	{
-		if (pair.second.ID >= 0)
-		{
-			std::cout << "Shader program destroyed with ID : " << pair.second.ID << std::endl;
-			glDeleteProgram(pair.second.ID);
-		}
-	}
+	// The source's own folders are mirrored below the cache folder, without leaving it.
+	std::filesystem::path cachePath(CACHE_DIRECTORY);
+	for (const std::filesystem::path& part : std::filesystem::path(sourcePath).lexically_normal().relative_path())
+		cachePath /= part == ".." ? std::filesystem::path("__") : part;
+	return cachePath.generic_string() + extension;
+}
 
-	for (auto& pair : postProcessingShaders)
+bool Engine::CreateCacheFolders(const std::string& cachePath)
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+	if (error)
 	{
-		if (pair.second.ID >= 0)
-		{
-			std::cout << "Shader program destroyed with ID : " << pair.second.ID << std::endl;
-			glDeleteProgram(pair.second.ID);
-		}
+		std::cout << "ERROR::ENGINE::Could not create the folders of " << cachePath << ": " << error.message() << std::endl;
+		return false;
 	}
 
-	// Terminate.
-	glfwTerminate();
+	// Generated files never belong in the repository.
+	std::filesystem::path ignorePath = std::filesystem::path(CACHE_DIRECTORY) / ".gitignore";
+	if (!std::filesystem::exists(ignorePath, error))
+		std::ofstream(ignorePath) << "*" << std::endl;
+	return true;
+}
+
+Engine::~Engine()
+{
+	// Background loads refer to members destroyed before the thread pool.
+	threadPool.Wait();
+
+	glDeleteQueries(2, fragmentQueries);
+
+	// Models go before the textures and geometry they hold. GLFW is terminated after the remaining members are
+	// destroyed, by glfwTerminator.
+	assets.Clear();
 }
 
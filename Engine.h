@@ -2,15 +2,33 @@
 
 #include <glad/glad.h>
 #include <glfw/glfw3.h>
+#include <condition_variable>
 #include <memory>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
 
 #include "Input.h"
-#include "Texture2D.h"
+#include "TextureCache.h"
+#include "AssetRegistry.h"
 #include "Shader.h"
+#include "TransparentQueue.h"
+#include "StreamingBuffer.h"
+#include "GeometryArena.h"
+#include "UploadQueue.h"
+#include "TextureCooker.h"
+#include "MaterialTable.h"
+#include "ThreadPool.h"
+#include "OcclusionCuller.h"
+#include "GpuProfiler.h"
+#include "FrameLimiter.h"
+#include "RenderGraph.h"
+#include "PostProcessChain.h"
+#include "DynamicResolution.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
 
 
 struct cCamera;
@@ -19,21 +37,73 @@ class EntityManager;
 class Entity;
 struct Component;
 class Model;
-struct cModel;
 class Framebuffer;
+struct cModel;
 
-typedef std::map<ShaderType, Shader> ShaderMap;
 typedef std::map<unsigned int, ActionType> ActionMap;
 typedef std::map<std::string, std::shared_ptr<Scene>> SceneMap;
-typedef std::map<std::string, std::shared_ptr<Model>> ModelMap;
-typedef std::map<Primitive, std::shared_ptr<Model>> PrimitiveModelMap;
-typedef std::map<float, Entity*> BlendMap;
-typedef std::map<FramebufferType, std::shared_ptr<Framebuffer>> FramebufferMap;
+
+struct FrameStats
+{
+	// Fragments that passed the depth test in the shading passes (GL_SAMPLES_PASSED).
+	unsigned long long	fragmentsShaded		= 0;
+	// Shaded fragments per screen pixel.
+	float				overdraw			= 0.0f;
+	// Times the CPU had to wait for the GPU before reusing streaming buffer memory.
+	unsigned int		streamingStalls		= 0;
+	// Bytes streamed to the GPU by the upload queue, and bytes still queued.
+	size_t				uploadedBytes		= 0;
+	size_t				pendingUploadBytes	= 0;
+	// State changing GL calls that reached the driver, and those dropped as redundant.
+	unsigned int		glCallsIssued		= 0;
+	unsigned int		glCallsFiltered		= 0;
+	// Draw calls and triangles submitted, multi-draws count once.
+	unsigned int		drawCalls			= 0;
+	unsigned long long	triangles			= 0;
+	// Entities drawn at each level of detail.
+	unsigned int		entitiesPerLod[MAX_GEOMETRY_LODS] = {};
+	// Occlusion culling results and the number of occluder triangles rasterized.
+	unsigned int		entitiesVisible		= 0;
+	unsigned int		entitiesOccluded	= 0;
+	unsigned int		entitiesOutsideView	= 0;
+	unsigned int		occluderTriangles	= 0;
+	// Fixed simulation steps taken this frame.
+	unsigned int		simulationSteps		= 0;
+	// Scale of the screen resolution the scene was rendered at.
+	float				resolutionScale		= 1.0f;
+};
+
+// Layouts of the std140 uniform blocks sourced from the streaming buffer.
+struct FrameData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	// x: time since creation.
+	glm::vec4 timeParams;
+};
+
+struct ObjectData
+{
+	glm::mat4 model;
+	// Upper 3x3 is the normal matrix, padded to a mat4 to keep std140 layout simple.
+	glm::mat4 normalMatrix;
+};
+
+const unsigned int FRAME_DATA_BINDING  = 0;
+const unsigned int OBJECT_DATA_BINDING = 1;
 
 class Engine
 {
 private:
 	Engine();
+
+	// Terminates GLFW, and with it the context, when destroyed. Declared before every other member so that it is
+	// destroyed last, after the members deleting their GL objects.
+	struct GlfwTerminator
+	{
+		~GlfwTerminator() { glfwTerminate(); }
+	};
+	GlfwTerminator					glfwTerminator;
 public:
 	static Engine& Instance();
 	~Engine();
@@ -45,23 +115,107 @@ public:
 	static unsigned int				SCREEN_WIDTH;
 	static unsigned int				SCREEN_HEIGHT;
 	static bool						FULLSCREEN;
+	// Render offscreen into a Framebuffer behind an invisible window, without presenting. Must be set before the
+	// first call to Instance().
+	static bool						HEADLESS;
+	// GLFW_NATIVE_CONTEXT_API, GLFW_EGL_CONTEXT_API or GLFW_OSMESA_CONTEXT_API. OSMesa renders on the CPU through
+	// llvmpipe. Must be set before the first call to Instance().
+	static int						CONTEXT_CREATION_API;
+	// Folder for generated files such as cooked textures, kept apart from the source assets. It ignores itself in git.
+	static std::string				CACHE_DIRECTORY;
 	bool							WIREFRAME						= false;
+	// Pack model textures into texture arrays and draw from a material table. Must be set before Run().
+	bool							TEXTURE_ARRAYS					= false;
+	// Vertex layout used for model geometry. Models fall back to STANDARD when their data does not fit the format.
+	// Must be set before Run().
+	VertexFormat					VERTEX_FORMAT					= VertexFormat::COMPACT;
+	// Weld and reorder imported meshes for the vertex cache, overdraw and vertex fetch. Must be set before Run().
+	bool							OPTIMIZE_MESHES					= true;
+	// Generate simplified levels of detail at import and select one per entity by screen size. Must be set before Run().
+	bool							GENERATE_LODS					= true;
+	// Import models on the thread pool and upload each on the main thread as it finishes. Must be set before Run().
+	bool							PARALLEL_MODEL_LOADING			= true;
+	// Read imported models from binary caches next to their files, written on first import. Must be set before Run().
+	bool							MESH_CACHE						= true;
+	// Load models and compile shaders the first time they are asked for instead of all at startup. Models load in
+	// the background and draw as a box until they are ready. Must be set before Run().
+	bool							LAZY_LOADING					= true;
+	// Projected size, as a fraction of screen height, below which an entity switches to the next level of detail.
+	float							lodScreenSizes[MAX_GEOMETRY_LODS - 1] = { 0.3f, 0.15f, 0.07f };
+	// Relative margin around each switch size, so that entities near it do not flicker between levels.
+	float							lodHysteresis					= 0.1f;
+	// Cull entities hidden behind large occluders with a CPU depth buffer, and entities outside the view. Must be set
+	// before Run().
+	bool							OCCLUSION_CULLING				= false;
+	// Minimum projected size, as a fraction of screen height, for a model to be rasterized as an occluder.
+	float							occluderScreenSize				= 0.1f;
+	// Time render passes on the GPU. The report is printed when the engine stops, and written as CSV to
+	// gpuProfileCsvPath if it is set.
+	bool							GPU_PROFILING					= true;
+	std::string						gpuProfileCsvPath;
+	// Advance the simulation (input actions, scene updates, movement) in fixed steps and interpolate transforms
+	// between the last two steps when rendering. Otherwise the simulation advances once per rendered frame.
+	bool							FIXED_TIMESTEP					= true;
+	double							simulationRate					= 60.0;
+	// Steps per frame are capped so that a slow frame cannot make the next one slower. Excess time is dropped.
+	unsigned int					maxSimulationSteps				= 5;
+	// Frames per second to pace rendering to, 0 for unlimited. Read when Run() starts.
+	double							frameRateLimit					= 0.0;
+	// Run() returns after this many frames or seconds, 0 for no limit.
+	unsigned long long				maxFrames						= 0;
+	double							maxDuration						= 0.0;
+	// Drives the main camera during simulation steps when it has keyframes, time starts with the first step.
+	CameraPath						cameraPath;
+	// Record per-frame timings into benchmark. The simulation then advances exactly one step per frame, so every run
+	// renders the same sequence of frames regardless of how long they take.
+	bool							BENCHMARK						= false;
+	Benchmark						benchmark;
+	// Scene started by Run(), a default scene if not set.
+	std::shared_ptr<Scene>			startScene						= nullptr;
+	// Render the scene at a scale of the screen resolution that dynamicResolution adjusts to hold its target frame
+	// time, and upscale it with sharpening. Frame time is measured on the GPU when GPU_PROFILING is set.
+	bool							DYNAMIC_RESOLUTION				= false;
+	DynamicResolution				dynamicResolution;
+	float							upscaleSharpness				= 0.25f;
+	// Outline thickness in pixels of the scene target. Drawing costs grow with it, not with the number of entities.
+	int								outlineWidth					= 3;
+	// Size of the outline color table in outlineEdges.frag. Entities past it share its last color.
+	static const unsigned int		MAX_OUTLINE_COLORS				= 64;
 
 	float							inputMouseSensitivity			= 0.1f;
 	bool							inputCameraConstrainPitch		= true;
 	
 	glm::vec3						worldUp							{ 0.0f, 1.0f, 0.0f };
 
+	// Length of the current simulation step. frameTime is the length of the last rendered frame.
 	double							deltaTime						= 0.0f;
+	double							frameTime						= 0.0f;
 
 	bool							firstMouse						= true;
 	double							lastMouseX;
 	double							lastMouseY;
 
-	Texture2D						defaultTexture;
+	// Texture and geometry data is streamed to the GPU through uploadQueue, at most uploadBudget bytes per frame,
+	// and textures are decoded on the thread pool. Read when the engine starts.
+	bool							ASYNC_UPLOADS					= true;
+	size_t							uploadBudget					= 4 << 20;
+	UploadQueue						uploadQueue						{ 16 << 20 };
+	// Load textures through cooked files with precomputed, block compressed mip chains. Files are cooked on first use.
+	bool							COOK_TEXTURES					= true;
+	TextureCookSettings				textureCookSettings;
+	// Owns every texture, shared by path and by file contents. Declared before everything holding handles.
+	TextureCache					textureCache;
+	TextureHandle					defaultTexture;
+	// Shared vertex and index storage for all meshes. Declared before the asset registry so it outlives the models.
+	GeometryArena					geometryArena					{ 1 << 20, 4 << 20 };
+	MaterialTable					materialTable;
+	// Owns models and shaders, components refer to them by handle.
+	AssetRegistry					assets;
+	// Workers for CPU-side frame work.
+	ThreadPool						threadPool;
+	GpuProfiler						gpuProfiler;
 
 	cCamera*						mainCamera						= nullptr;
-	ShaderMap						shaderMap;
 	Shader							activeShader;
 
 	// An action map is a mapping from keys to Actions.
@@ -72,16 +226,18 @@ public:
 	SceneMap						sceneMap;
 	std::shared_ptr<Scene>			activeScene						= nullptr;
 
-	ModelMap						models;
-	PrimitiveModelMap				primitiveModels;
+	// Transparent draws of the current frame, rebuilt every frame.
+	TransparentQueue				transparentQueue;
+	TransparencySortMode			transparencySortMode			= TransparencySortMode::PER_ENTITY;
 
-	BlendMap						blendMap;
+	ModelHandle						postProcessingQuadModel;
+	// Effects applied to the scene when POST_PROCESSING is set, empty for a plain copy.
+	PostProcessChain				postProcessChain;
+	// Rebuilt every frame in Render(), owns the pooled framebuffers of transient targets.
+	RenderGraph						renderGraph;
 
-	FramebufferMap				    framebuffers;
-	std::unique_ptr<Entity>			postProcessingQuad;
-	std::shared_ptr<Model>			postProcessingQuadModel;
-	ShaderMap						postProcessingShaders;
-	Shader							activePostProcessingShader;
+	// Statistics of the last frame whose GPU queries have completed.
+	FrameStats						frameStats;
 
 private:
 
@@ -89,6 +245,22 @@ private:
 
 	double					currentTime						= 0.0f;
 	double					startTime						= 0.0f;
+	double					simulationAccumulator			= 0.0f;
+	double					simulationTime					= 0.0f;
+	unsigned long long		frameCount						= 0;
+	// Start of the current frame's work, and the length of the last frame's work up to presenting, which excludes
+	// waiting for vsync and for the frame limiter.
+	double					frameStartTime					= 0.0;
+	double					frameWorkTime					= 0.0;
+	bool					initialized						= false;
+	// Stands in for the default framebuffer in headless mode.
+	std::unique_ptr<Framebuffer> headlessTarget;
+	// Size of the scene target of the current frame.
+	unsigned int			renderWidth						= 0;
+	unsigned int			renderHeight					= 0;
+	// Fraction of a simulation step between the previous and the current state that is rendered.
+	float					interpolationAlpha				= 1.0f;
+	FrameLimiter			frameLimiter;
 
 	// Perspective data.
 	float					FOV								= 45.0f;
@@ -106,9 +278,23 @@ private:
 
 	bool					BLEND							= true;
 	bool					POST_PROCESSING					= false;
+	bool					DEPTH_PREPASS					= false;
+
+	// Occlusion queries counting shaded fragments, double buffered to avoid stalling.
+	unsigned int			fragmentQueries[2]				= { 0, 0 };
+	unsigned int			fragmentQueryFrame				= 0;
+
+	// Per-frame transient data. Draws reference their matrices by offset into this buffer.
+	StreamingBuffer			streamingBuffer					{ GL_UNIFORM_BUFFER, 4 * 1024 * 1024 };
+	std::vector<GLintptr>	objectDataOffsets;
+
+	OcclusionCuller			occlusionCuller;
+	// Entities tested by the occlusion culler this frame, with their occludee index.
+	std::vector<std::pair<Entity*, unsigned int>> culledEntities;
 
 public:
-	void Run();
+	// Returns an ExitCode.
+	int Run();
 
 public:
 	Entity AddEntity(const std::string& name);
@@ -144,8 +330,8 @@ private:
 	glm::mat4 view = glm::mat4(1.0f);
 	glm::mat4 projection = glm::mat4(1.0f);
 
-	void CalculateViewMatrix(Shader& shader);
-	void CalculateProjectionMatrix(Shader& shader);
+	void CalculateViewMatrix();
+	void CalculateProjectionMatrix();
 	void CalculateLighting(Shader& shader);
 	void CalculateSpotlights(Shader& shader);
 	void CalculatePointLights(Shader& shader);
@@ -159,15 +345,36 @@ private:
 	void Render();
 	void NormalRender();
 	void BlendRender();
-	void DrawEntity(Entity e);
-	void DrawOutlinedModel(Entity e, cModel& model);
-
-	void EnablePostProcessing();
+	void UploadTransientData();
+	// Returns false, binding nothing, for entities without object data this frame.
+	bool BindObjectData(GLintptr offset);
+	void DepthPrepass();
+	void DrawOpaqueEntities(bool skipTransparent);
+	bool IsDepthPrepassCandidate(Entity& e);
+	void BeginFragmentCounter();
+	void EndFragmentCounter();
+	glm::mat4 CalculateModelMatrix(Entity& e, float scaleFactor = 1.0f);
+	// Projected diameter of the model's bounding sphere as a fraction of screen height.
+	float CalculateScreenSize(const Model& model, const glm::mat4& modelMatrix) const;
+	void SelectLod(cModel& entityModel, const Model& model, const glm::mat4& modelMatrix);
+	void CullEntities();
+	void BeginGpuPass(const char* name);
+	void EndGpuPass();
+	void QueueTransparentEntity(Entity& e, uint32_t entityIndex);
+	// Draws all meshes of the entity's model, or only meshIndex if it is not TransparentQueue::ALL_MESHES.
+	void DrawEntity(Entity& e, uint32_t meshIndex = TransparentQueue::ALL_MESHES);
+	// Writes the outline color table index of every outlined entity into the bound mask target.
+	void DrawOutlineMask();
+	void DrawOutlineEdges(const RenderGraph& graph, RenderResource mask);
 
 	std::vector<Entity> outlinedObjects;
 
 public:
 	double GetTimeSinceCreation() const;
+	// Path under CACHE_DIRECTORY of the file generated from sourcePath, with extension appended.
+	static std::string GetCachePath(const std::string& sourcePath, const std::string& extension);
+	// Creates the folders of a cache path about to be written. Thread safe. Returns false if they cannot be created.
+	static bool CreateCacheFolders(const std::string& cachePath);
 
 public:
 	void BindInputKey(unsigned int key, ActionType action);
@@ -184,8 +391,65 @@ public:
 	void RemoveOutline(Entity e);
 	void SetBlending(bool blend, GLenum sourceFactor = GL_SRC_ALPHA, GLenum destinationFactor = GL_ONE_MINUS_SRC_ALPHA);
 	void SetPostProcessing(bool postProcessing);
+	void SetDepthPrepass(bool depthPrepass);
+
+public:
+	// Model of a folder in models/custom_models, loaded on the first request. With PARALLEL_MODEL_LOADING the model
+	// is returned right away and draws as a placeholder until its load finishes in a later frame.
+	ModelHandle					GetModel(const std::string& name);
+	ModelHandle					GetModel(Primitive primitive) const;
+	std::vector<std::string>	GetModelNames() const;
+	// Frees the model once the GPU is done with it. Entities still referring to it stop drawing it.
+	void						UnloadModel(const std::string& name);
+	// Blocks until every requested model is loaded.
+	void						WaitForModels();
+	// Compiles the shader on its first use.
+	Shader&						GetShader(ShaderType type);
+
+private:
+	struct ShaderSource
+	{
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::string defines;
+		bool        postProcessing	= false;
+	};
+
+	// A model whose CPU phase has run on the thread pool, into staging, waiting for its GL phase.
+	struct ModelLoad
+	{
+		ModelHandle            model;
+		std::unique_ptr<Model> staging;
+		bool                   prepared		= false;
+		double                 prepareTime		= 0.0;
+	};
+
+	std::map<ShaderType, ShaderSource>	shaderSources;
+	std::map<ShaderType, ShaderHandle>	shaders;
+	// Model files by name, found when the engine starts.
+	std::map<std::string, std::string>	modelFiles;
+	ModelHandle							placeholderModel;
+	// Indexed by Primitive.
+	std::vector<ModelHandle>			primitiveModels;
+	std::mutex							modelLoadMutex;
+	std::condition_variable				modelLoadFinished;
+	std::vector<ModelLoad>				finishedModelLoads;
+	unsigned int						pendingModelLoads		= 0;
+	// Models imported from their files and models read from the mesh cache, with their summed load times.
+	unsigned int						coldModelLoads			= 0;
+	unsigned int						warmModelLoads			= 0;
+	double								coldModelLoadTime		= 0.0;
+	double								warmModelLoadTime		= 0.0;
+
+	// Runs the GL phase of finished loads. If wait is set, blocks until no load is pending.
+	void FinishModelLoads(bool wait);
+	void FinishModelLoad(ModelLoad& load);
 
 private:
 	void TransformEntities();
+	// Runs one simulation step of deltaTime.
+	void Simulate();
+	void FollowCameraPath();
+	void SaveSimulationState();
 	void InitializeCamera();
 };
\ No newline at end of file
@@ -60,13 +60,16 @@ enum class ShaderType
 	DEFAULT,
 	LIGHT_SOURCE,
 	OUTLINE,
+	OUTLINE_EDGES,
+	DEPTH_PREPASS,
 	POST_PROCESSING_DEFAULT,
 	COLOR_INVERSION,
 	GRAYSCALE,
 	SHARPEN,
 	BLUR,
 	EDGE_DETECTION,
-	CUSTOM_EFFECT
+	CUSTOM_EFFECT,
+	UPSCALE
 };
 
 enum class Primitive
@@ -74,7 +77,19 @@ enum class Primitive
 	QUAD
 };
 
-enum class FramebufferType
+// Process exit codes returned by Engine::Run().
+enum class ExitCode
 {
-	POST_PROCESSING
+	SUCCESS					= 0,
+	INITIALIZATION_FAILED	= 1,
+	GL_ERROR				= 2,
+	INVALID_ARGUMENTS		= 3,
+	// Returned by main when a benchmark run was slower than its baseline.
+	BENCHMARK_REGRESSION	= 4
+};
+
+enum class TransparencySortMode
+{
+	PER_ENTITY,
+	PER_MESH
 };
\ No newline at end of file
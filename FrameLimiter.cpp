@@ -0,0 +1,42 @@
+#include "FrameLimiter.h"
+
+#include <thread>
+
+void FrameLimiter::SetTargetRate(double hz)
+{
+	targetRate = hz > 0.0 ? hz : 0.0;
+	frameDuration = targetRate > 0.0
+		? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetRate))
+		: Clock::duration(0);
+	started = false;
+}
+
+double FrameLimiter::GetTargetRate() const
+{
+	return targetRate;
+}
+
+void FrameLimiter::Wait()
+{
+	if (targetRate <= 0.0)
+		return;
+
+	Clock::time_point now = Clock::now();
+	if (!started)
+	{
+		nextFrame = now + frameDuration;
+		started = true;
+		return;
+	}
+
+	if (nextFrame - now > spinMargin)
+		std::this_thread::sleep_for(nextFrame - now - spinMargin);
+	while (Clock::now() < nextFrame)
+		std::this_thread::yield();
+
+	// Deadlines advance by whole frames so pacing does not drift. After a long frame the schedule restarts from
+	// now instead of rushing to catch up.
+	nextFrame += frameDuration;
+	if (nextFrame < Clock::now())
+		nextFrame = Clock::now() + frameDuration;
+}
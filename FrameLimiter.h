@@ -0,0 +1,26 @@
+#pragma once
+
+#include <chrono>
+
+// Paces frames to a target rate. Sleeps for most of the remaining frame time and spins for the last part, since
+// sleeping alone overshoots by the scheduler's granularity.
+class FrameLimiter
+{
+public:
+	// 0 disables the limiter.
+	void SetTargetRate(double hz);
+	double GetTargetRate() const;
+	// Blocks until the current frame has lasted its full duration, then starts the next one.
+	void Wait();
+
+	// Time left to the spin loop.
+	std::chrono::microseconds spinMargin	{ 2000 };
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	double            targetRate		= 0.0;
+	Clock::duration   frameDuration		{ 0 };
+	Clock::time_point nextFrame;
+	bool              started			= false;
+};
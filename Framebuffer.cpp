@@ -1,8 +1,11 @@
 #include "Framebuffer.h"
+#include "GLState.h"
+#include "Engine.h"
+
 #include <iostream>
 
-Framebuffer::Framebuffer(unsigned int Width, unsigned int Height)
-	: width{Width}, height{Height}
+Framebuffer::Framebuffer(unsigned int Width, unsigned int Height, bool DepthStencil)
+	: depthStencil{DepthStencil}, width{Width}, height{Height}
 {}
 
 void Framebuffer::Generate()
@@ -10,21 +13,26 @@ void Framebuffer::Generate()
 	// Generate buffer.
 	glGenFramebuffers(1, &ID);
 	// Bind buffer.
-	glBindFramebuffer(bufferType, ID);
+	GLState::Instance().BindFramebuffer(bufferType, ID);
 	// Generate, bind, allocate and attach color buffer.
-	colorBuffer.CreateAsBuffer(bufferType, width, height);
+	Texture2D texture;
+	texture.CreateAsBuffer(bufferType, width, height);
+	colorBuffer = Engine::Instance().textureCache.Add(texture);
 	// Generate, bind allocate and attach render buffer.
-	glGenRenderbuffers(1, &renderBuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, renderBuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glFramebufferRenderbuffer(bufferType, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderBuffer);
+	if (depthStencil)
+	{
+		glGenRenderbuffers(1, &renderBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glFramebufferRenderbuffer(bufferType, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderBuffer);
+	}
 	// Check status.
 	status = glCheckFramebufferStatus(bufferType);
 	if (status != GL_FRAMEBUFFER_COMPLETE)
 		std::cout << "ERROR::FRAMEBUFFER::Framebuffer with ID: " << ID << " is not complete." << std::endl;
 	// Unbind buffer.
-	glBindFramebuffer(bufferType, 0);
+	GLState::Instance().BindFramebuffer(bufferType, 0);
 }
 
 void Framebuffer::SetBufferType(GLenum type)
@@ -44,22 +52,32 @@ GLenum Framebuffer::CheckStatus() const
 
 void Framebuffer::Bind()
 {
-	glBindFramebuffer(bufferType, ID);
+	GLState::Instance().BindFramebuffer(bufferType, ID);
 }
 
 void Framebuffer::Unbind()
 {
-	glBindFramebuffer(bufferType, 0);
+	GLState::Instance().BindFramebuffer(bufferType, 0);
 }
 
-Texture2D Framebuffer::GetColorBuffer() const
+const TextureHandle& Framebuffer::GetColorBuffer() const
 {
 	return colorBuffer;
 }
 
+unsigned int Framebuffer::GetWidth() const
+{
+	return width;
+}
+
+unsigned int Framebuffer::GetHeight() const
+{
+	return height;
+}
+
 Framebuffer::~Framebuffer()
 {
-	glDeleteFramebuffers(1, &ID);
-	glDeleteRenderbuffers(1, &renderBuffer);
-	glDeleteTextures(1, &colorBuffer.ID);
+	GLState::Instance().DeleteFramebuffers(1, &ID);
+	if (renderBuffer)
+		glDeleteRenderbuffers(1, &renderBuffer);
 }
\ No newline at end of file
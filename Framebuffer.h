@@ -1,11 +1,12 @@
 #pragma once
 
-#include "Texture2D.h"
+#include "TextureCache.h"
 
 class Framebuffer
 {
 public:
-	Framebuffer(unsigned int Width, unsigned int Height);
+	// Targets that are only sampled, like post-processing intermediates, need no depth and stencil buffer.
+	Framebuffer(unsigned int Width, unsigned int Height, bool DepthStencil = true);
 
 	void      Generate();
 	void      SetBufferType(GLenum type);
@@ -13,13 +14,17 @@ public:
 	void      Bind();
 	void      Unbind();
 	GLenum    CheckStatus() const;
-	Texture2D GetColorBuffer() const;
+	const TextureHandle& GetColorBuffer() const;
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
 
 	~Framebuffer();
 private:
 	unsigned int ID;
-	Texture2D    colorBuffer;
-	unsigned int renderBuffer;
+	// Owned through the engine's texture cache, so it lives on while handles to it remain.
+	TextureHandle colorBuffer;
+	unsigned int renderBuffer	= 0;
+	bool         depthStencil;
 	GLenum       bufferType = GL_FRAMEBUFFER;
 	unsigned int width;
 	unsigned int height;
@@ -0,0 +1,379 @@
+#include "GLState.h"
+
+GLState::GLState()
+{
+	Invalidate();
+}
+
+void GLState::Invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+	{
+		textures2D[i] = UNKNOWN;
+		textureArrays[i] = UNKNOWN;
+	}
+	drawFramebuffer = UNKNOWN;
+	readFramebuffer = UNKNOWN;
+	for (unsigned int i = 0; i < MAX_BUFFER_BINDINGS; ++i)
+	{
+		uniformBuffers[i] = { UNKNOWN, -1, -1 };
+	}
+	for (int& capability : capabilities)
+	{
+		capability = -1;
+	}
+	depthFunc = UNKNOWN;
+	depthMask = -1;
+	colorMask = UNKNOWN;
+	stencilFunc = UNKNOWN;
+	stencilRef = -1;
+	stencilFuncMask = UNKNOWN;
+	stencilMask = UNKNOWN;
+	stencilOps[0] = stencilOps[1] = stencilOps[2] = UNKNOWN;
+	blendFactors[0] = blendFactors[1] = UNKNOWN;
+	clearColor[0] = clearColor[1] = clearColor[2] = clearColor[3] = -1.0f;
+	viewport[0] = viewport[1] = viewport[2] = viewport[3] = -1;
+}
+
+bool GLState::Changed(bool changed)
+{
+	if (changed)
+		++issuedCalls;
+	else
+		++filteredCalls;
+	return changed;
+}
+
+int GLState::CapabilityIndex(GLenum capability) const
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST:		return 0;
+	case GL_STENCIL_TEST:	return 1;
+	case GL_CULL_FACE:		return 2;
+	case GL_BLEND:			return 3;
+	default:				return -1;
+	}
+}
+
+void GLState::UseProgram(unsigned int Program)
+{
+	if (Changed(program != Program))
+	{
+		program = Program;
+		glUseProgram(Program);
+	}
+}
+
+void GLState::BindVertexArray(unsigned int VertexArray)
+{
+	if (Changed(vertexArray != VertexArray))
+	{
+		vertexArray = VertexArray;
+		glBindVertexArray(VertexArray);
+	}
+}
+
+void GLState::ActiveTexture(unsigned int unit)
+{
+	if (Changed(activeUnit != unit))
+	{
+		activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+}
+
+void GLState::BindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+	ActiveTexture(unit);
+	BindTexture(target, texture);
+}
+
+void GLState::BindTexture(GLenum target, unsigned int texture)
+{
+	unsigned int* bound = nullptr;
+	if (activeUnit < MAX_TEXTURE_UNITS)
+	{
+		if (target == GL_TEXTURE_2D)
+			bound = &textures2D[activeUnit];
+		else if (target == GL_TEXTURE_2D_ARRAY)
+			bound = &textureArrays[activeUnit];
+	}
+
+	if (!bound)
+	{
+		++issuedCalls;
+		glBindTexture(target, texture);
+	}
+	else if (Changed(*bound != texture))
+	{
+		*bound = texture;
+		glBindTexture(target, texture);
+	}
+}
+
+void GLState::BindFramebuffer(GLenum target, unsigned int framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	if (Changed((draw && drawFramebuffer != framebuffer) || (read && readFramebuffer != framebuffer)))
+	{
+		if (draw)
+			drawFramebuffer = framebuffer;
+		if (read)
+			readFramebuffer = framebuffer;
+		glBindFramebuffer(target, framebuffer);
+	}
+}
+
+void GLState::BindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+{
+	if (target != GL_UNIFORM_BUFFER || index >= MAX_BUFFER_BINDINGS)
+	{
+		++issuedCalls;
+		glBindBufferBase(target, index, buffer);
+		return;
+	}
+
+	BufferRange& bound = uniformBuffers[index];
+	if (Changed(bound.buffer != buffer || bound.offset != 0 || bound.size != 0))
+	{
+		bound = { buffer, 0, 0 };
+		glBindBufferBase(target, index, buffer);
+	}
+}
+
+void GLState::BindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (target != GL_UNIFORM_BUFFER || index >= MAX_BUFFER_BINDINGS)
+	{
+		++issuedCalls;
+		glBindBufferRange(target, index, buffer, offset, size);
+		return;
+	}
+
+	BufferRange& bound = uniformBuffers[index];
+	if (Changed(bound.buffer != buffer || bound.offset != offset || bound.size != size))
+	{
+		bound = { buffer, offset, size };
+		glBindBufferRange(target, index, buffer, offset, size);
+	}
+}
+
+void GLState::SetEnabled(GLenum capability, bool enabled)
+{
+	int index = CapabilityIndex(capability);
+	if (index < 0)
+	{
+		++issuedCalls;
+		enabled ? glEnable(capability) : glDisable(capability);
+		return;
+	}
+
+	if (Changed(capabilities[index] != int(enabled)))
+	{
+		capabilities[index] = int(enabled);
+		enabled ? glEnable(capability) : glDisable(capability);
+	}
+}
+
+void GLState::Enable(GLenum capability)
+{
+	SetEnabled(capability, true);
+}
+
+void GLState::Disable(GLenum capability)
+{
+	SetEnabled(capability, false);
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+	if (Changed(depthFunc != func))
+	{
+		depthFunc = func;
+		glDepthFunc(func);
+	}
+}
+
+void GLState::DepthMask(GLboolean flag)
+{
+	if (Changed(depthMask != int(flag)))
+	{
+		depthMask = int(flag);
+		glDepthMask(flag);
+	}
+}
+
+void GLState::ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	unsigned int mask = (red ? 1u : 0u) | (green ? 2u : 0u) | (blue ? 4u : 0u) | (alpha ? 8u : 0u);
+	if (Changed(colorMask != mask))
+	{
+		colorMask = mask;
+		glColorMask(red, green, blue, alpha);
+	}
+}
+
+void GLState::StencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+	if (Changed(stencilFunc != func || stencilRef != ref || stencilFuncMask != mask))
+	{
+		stencilFunc = func;
+		stencilRef = ref;
+		stencilFuncMask = mask;
+		glStencilFunc(func, ref, mask);
+	}
+}
+
+void GLState::StencilMask(GLuint mask)
+{
+	if (Changed(stencilMask != mask))
+	{
+		stencilMask = mask;
+		glStencilMask(mask);
+	}
+}
+
+void GLState::StencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+{
+	if (Changed(stencilOps[0] != stencilFail || stencilOps[1] != depthFail || stencilOps[2] != depthPass))
+	{
+		stencilOps[0] = stencilFail;
+		stencilOps[1] = depthFail;
+		stencilOps[2] = depthPass;
+		glStencilOp(stencilFail, depthFail, depthPass);
+	}
+}
+
+void GLState::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	if (Changed(blendFactors[0] != sourceFactor || blendFactors[1] != destinationFactor))
+	{
+		blendFactors[0] = sourceFactor;
+		blendFactors[1] = destinationFactor;
+		glBlendFunc(sourceFactor, destinationFactor);
+	}
+}
+
+void GLState::ClearColor(float r, float g, float b, float a)
+{
+	if (Changed(clearColor[0] != r || clearColor[1] != g || clearColor[2] != b || clearColor[3] != a))
+	{
+		clearColor[0] = r;
+		clearColor[1] = g;
+		clearColor[2] = b;
+		clearColor[3] = a;
+		glClearColor(r, g, b, a);
+	}
+}
+
+void GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (Changed(viewport[0] != x || viewport[1] != y || viewport[2] != width || viewport[3] != height))
+	{
+		viewport[0] = x;
+		viewport[1] = y;
+		viewport[2] = width;
+		viewport[3] = height;
+		glViewport(x, y, width, height);
+	}
+}
+
+void GLState::DeleteTextures(GLsizei count, const unsigned int* Textures)
+{
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+		{
+			if (textures2D[unit] == Textures[i])
+				textures2D[unit] = 0;
+			if (textureArrays[unit] == Textures[i])
+				textureArrays[unit] = 0;
+		}
+	}
+	glDeleteTextures(count, Textures);
+}
+
+void GLState::DeleteProgram(unsigned int Program)
+{
+	if (program == Program)
+		program = UNKNOWN;
+	glDeleteProgram(Program);
+}
+
+void GLState::DeleteVertexArrays(GLsizei count, const unsigned int* vertexArrays)
+{
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		if (vertexArray == vertexArrays[i])
+			vertexArray = 0;
+	}
+	glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLState::DeleteFramebuffers(GLsizei count, const unsigned int* framebuffers)
+{
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		if (drawFramebuffer == framebuffers[i])
+			drawFramebuffer = 0;
+		if (readFramebuffer == framebuffers[i])
+			readFramebuffer = 0;
+	}
+	glDeleteFramebuffers(count, framebuffers);
+}
+
+void GLState::DeleteBuffers(GLsizei count, const unsigned int* buffers)
+{
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		for (BufferRange& bound : uniformBuffers)
+		{
+			if (bound.buffer == buffers[i])
+				bound = { 0, 0, 0 };
+		}
+	}
+	glDeleteBuffers(count, buffers);
+}
+
+void GLState::CountDraw(unsigned int DrawCalls, unsigned long long Triangles)
+{
+	drawCalls += DrawCalls;
+	triangles += Triangles;
+}
+
+void GLState::EndFrame()
+{
+	lastIssuedCalls = issuedCalls;
+	lastFilteredCalls = filteredCalls;
+	lastDrawCalls = drawCalls;
+	lastTriangles = triangles;
+	issuedCalls = 0;
+	filteredCalls = 0;
+	drawCalls = 0;
+	triangles = 0;
+}
+
+unsigned int GLState::GetIssuedCalls() const
+{
+	return lastIssuedCalls;
+}
+
+unsigned int GLState::GetFilteredCalls() const
+{
+	return lastFilteredCalls;
+}
+
+unsigned int GLState::GetDrawCalls() const
+{
+	return lastDrawCalls;
+}
+
+unsigned long long GLState::GetTriangles() const
+{
+	return lastTriangles;
+}
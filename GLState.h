@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Shadows the GL state the engine touches and drops calls that would not change it.
+// All engine code should change this state through here so that the shadow copy stays valid.
+class GLState
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS		= 16;
+	static const unsigned int MAX_BUFFER_BINDINGS	= 8;
+
+	// GLState is a singleton.
+	static GLState& Instance()
+	{
+		static GLState state;
+		return state;
+	}
+
+	void UseProgram(unsigned int program);
+	void BindVertexArray(unsigned int vertexArray);
+	void ActiveTexture(unsigned int unit);
+	// Binds on the given unit and leaves it active.
+	void BindTexture(unsigned int unit, GLenum target, unsigned int texture);
+	// Binds on the currently active unit.
+	void BindTexture(GLenum target, unsigned int texture);
+	void BindFramebuffer(GLenum target, unsigned int framebuffer);
+	void BindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+	void BindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+
+	void SetEnabled(GLenum capability, bool enabled);
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+	void DepthFunc(GLenum func);
+	void DepthMask(GLboolean flag);
+	void ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+	void StencilFunc(GLenum func, GLint ref, GLuint mask);
+	void StencilMask(GLuint mask);
+	void StencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+	void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+	void ClearColor(float r, float g, float b, float a);
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Deleting objects implicitly unbinds them, so the shadow copy has to forget them too.
+	void DeleteTextures(GLsizei count, const unsigned int* textures);
+	void DeleteProgram(unsigned int program);
+	void DeleteVertexArrays(GLsizei count, const unsigned int* vertexArrays);
+	void DeleteFramebuffers(GLsizei count, const unsigned int* framebuffers);
+	void DeleteBuffers(GLsizei count, const unsigned int* buffers);
+
+	// Forgets everything, e.g. after code outside the engine touched GL state.
+	void Invalidate();
+
+	// Draw calls go straight to GL, they are only counted here.
+	void CountDraw(unsigned int drawCalls, unsigned long long triangles);
+
+	// Latches the per-frame counters and resets them.
+	void EndFrame();
+	unsigned int GetIssuedCalls() const;
+	unsigned int GetFilteredCalls() const;
+	unsigned int GetDrawCalls() const;
+	unsigned long long GetTriangles() const;
+
+private:
+	GLState();
+
+	// Returns true if the call has to be issued, and counts it either way.
+	bool Changed(bool changed);
+	int  CapabilityIndex(GLenum capability) const;
+
+	static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int activeUnit;
+	unsigned int textures2D[MAX_TEXTURE_UNITS];
+	unsigned int textureArrays[MAX_TEXTURE_UNITS];
+	unsigned int drawFramebuffer;
+	unsigned int readFramebuffer;
+
+	struct BufferRange
+	{
+		unsigned int buffer;
+		GLintptr     offset;
+		GLsizeiptr   size;
+	};
+	BufferRange  uniformBuffers[MAX_BUFFER_BINDINGS];
+
+	// DEPTH_TEST, STENCIL_TEST, CULL_FACE, BLEND. 0: disabled, 1: enabled, -1: unknown.
+	int          capabilities[4];
+	GLenum       depthFunc;
+	int          depthMask;
+	unsigned int colorMask;
+	GLenum       stencilFunc;
+	GLint        stencilRef;
+	GLuint       stencilFuncMask;
+	GLuint       stencilMask;
+	GLenum       stencilOps[3];
+	GLenum       blendFactors[2];
+	float        clearColor[4];
+	GLint        viewport[4];
+
+	unsigned int issuedCalls			= 0;
+	unsigned int filteredCalls			= 0;
+	unsigned int lastIssuedCalls		= 0;
+	unsigned int lastFilteredCalls		= 0;
+	unsigned int drawCalls				= 0;
+	unsigned int lastDrawCalls			= 0;
+	unsigned long long triangles		= 0;
+	unsigned long long lastTriangles	= 0;
+};
@@ -0,0 +1,476 @@
+#include "GeometryArena.h"
+#include "Mesh.h"
+#include "GLState.h"
+#include "UploadQueue.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+// RangeAllocator
+// -------------------------------------------------------------------------------------------
+
+void RangeAllocator::Reset(size_t Capacity)
+{
+	freeRanges.clear();
+	capacity = Capacity;
+	used = 0;
+	if (capacity > 0)
+		freeRanges[0] = capacity;
+}
+
+void RangeAllocator::Grow(size_t newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	Free(capacity, newCapacity - capacity);
+	used += newCapacity - capacity;
+	capacity = newCapacity;
+}
+
+bool RangeAllocator::Allocate(size_t size, size_t& offset)
+{
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+	{
+		if (it->second >= size)
+		{
+			offset = it->first;
+			size_t remaining = it->second - size;
+			freeRanges.erase(it);
+			if (remaining > 0)
+				freeRanges[offset + size] = remaining;
+			used += size;
+			return true;
+		}
+	}
+	return false;
+}
+
+void RangeAllocator::Free(size_t offset, size_t size)
+{
+	used -= size;
+
+	// Merge with the following free range.
+	auto next = freeRanges.find(offset + size);
+	if (next != freeRanges.end())
+	{
+		size += next->second;
+		freeRanges.erase(next);
+	}
+
+	// Merge with the preceding free range.
+	auto it = freeRanges.lower_bound(offset);
+	if (it != freeRanges.begin())
+	{
+		auto previous = std::prev(it);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+
+	freeRanges[offset] = size;
+}
+
+size_t RangeAllocator::GetCapacity() const
+{
+	return capacity;
+}
+
+size_t RangeAllocator::GetUsed() const
+{
+	return used;
+}
+
+// GeometryArena
+// -------------------------------------------------------------------------------------------
+
+namespace
+{
+	struct StandardAttributes
+	{
+		glm::vec3 Normal;
+		glm::vec2 TextureCoords;
+	};
+
+	struct PackedAttributes
+	{
+		// GL_INT_2_10_10_10_REV, normalized.
+		uint32_t Normal;
+		// Two GL_HALF_FLOATs.
+		uint32_t TextureCoords;
+	};
+
+	struct QuantizedPosition
+	{
+		uint16_t x, y, z, padding;
+	};
+
+	uint16_t QuantizeUnorm16(float value)
+	{
+		return uint16_t(glm::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+}
+
+GeometryArena::GeometryArena(size_t VertexCapacity, size_t IndexCapacity)
+{
+	for (Pool& pool : pools)
+	{
+		pool.vertexRanges.Reset(VertexCapacity);
+		pool.indexRanges.Reset(IndexCapacity * sizeof(unsigned int));
+	}
+}
+
+size_t GeometryArena::PositionStride(VertexFormat format)
+{
+	return format == VertexFormat::QUANTIZED ? sizeof(QuantizedPosition) : sizeof(glm::vec3);
+}
+
+size_t GeometryArena::AttributeStride(VertexFormat format)
+{
+	return format == VertexFormat::STANDARD ? sizeof(StandardAttributes) : sizeof(PackedAttributes);
+}
+
+void GeometryArena::Generate(VertexFormat format, size_t vertexCapacity, size_t indexCapacity)
+{
+	Pool& pool = pools[size_t(format)];
+	glGenBuffers(1, &pool.positionVBO);
+	glGenBuffers(1, &pool.attributeVBO);
+	glGenBuffers(1, &pool.EBO);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool.positionVBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * PositionStride(format), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool.attributeVBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * AttributeStride(format), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, pool.EBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryArena::SetupVertexArrays(VertexFormat format)
+{
+	Pool& pool = pools[size_t(format)];
+	if (!pool.VAO)
+	{
+		glGenVertexArrays(1, &pool.VAO);
+		glGenVertexArrays(1, &pool.depthVAO);
+	}
+
+	auto setupPositions = [&]()
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, pool.positionVBO);
+		glEnableVertexAttribArray(0);
+		if (format == VertexFormat::QUANTIZED)
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedPosition), (void*)0);
+		else
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+	};
+
+	GLState::Instance().BindVertexArray(pool.VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO);
+
+	// Vertex Positions
+	setupPositions();
+
+	glBindBuffer(GL_ARRAY_BUFFER, pool.attributeVBO);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	if (format == VertexFormat::STANDARD)
+	{
+		// Vertex Normals
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(StandardAttributes), (void*)offsetof(StandardAttributes, Normal));
+		// Vertex Texture Coordinates
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(StandardAttributes), (void*)offsetof(StandardAttributes, TextureCoords));
+	}
+	else
+	{
+		// Vertex Normals
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedAttributes), (void*)offsetof(PackedAttributes, Normal));
+		// Vertex Texture Coordinates
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedAttributes), (void*)offsetof(PackedAttributes, TextureCoords));
+	}
+
+	// The depth-only vertex array reads positions and shares the index buffer.
+	GLState::Instance().BindVertexArray(pool.depthVAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO);
+	setupPositions();
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::Resize(VertexFormat format, size_t vertexCapacity, size_t indexCapacity, bool compact)
+{
+	// Queued uploads refer to the current buffers and offsets.
+	if (uploadQueue)
+		uploadQueue->Flush();
+
+	Pool& pool = pools[size_t(format)];
+	const size_t positionStride = PositionStride(format);
+	const size_t attributeStride = AttributeStride(format);
+
+	unsigned int oldPositionVBO = pool.positionVBO;
+	unsigned int oldAttributeVBO = pool.attributeVBO;
+	unsigned int oldEBO = pool.EBO;
+
+	Generate(format, vertexCapacity, indexCapacity);
+
+	auto copy = [](unsigned int source, unsigned int destination, size_t sourceOffset, size_t destinationOffset, size_t size)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, source);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, destinationOffset, size);
+	};
+
+	if (!compact)
+	{
+		// Keep every allocation where it is.
+		copy(oldPositionVBO, pool.positionVBO, 0, 0, pool.vertexRanges.GetCapacity() * positionStride);
+		copy(oldAttributeVBO, pool.attributeVBO, 0, 0, pool.vertexRanges.GetCapacity() * attributeStride);
+		copy(oldEBO, pool.EBO, 0, 0, pool.indexRanges.GetCapacity());
+		pool.vertexRanges.Grow(vertexCapacity);
+		pool.indexRanges.Grow(indexCapacity);
+	}
+	else
+	{
+		// Pack live allocations in order of their current position.
+		std::vector<GeometryAllocation*> live;
+		for (GeometryAllocation& allocation : allocations)
+		{
+			if (allocation.live && allocation.format == format)
+				live.push_back(&allocation);
+		}
+		std::sort(live.begin(), live.end(), [](GeometryAllocation* a, GeometryAllocation* b) { return a->baseVertex < b->baseVertex; });
+
+		pool.vertexRanges.Reset(vertexCapacity);
+		pool.indexRanges.Reset(indexCapacity);
+		for (GeometryAllocation* allocation : live)
+		{
+			size_t indexBytes = allocation->indexCount * (allocation->indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+			size_t vertexOffset, indexOffset;
+			pool.vertexRanges.Allocate(allocation->vertexCount, vertexOffset);
+			pool.indexRanges.Allocate((indexBytes + 3) & ~size_t(3), indexOffset);
+
+			copy(oldPositionVBO, pool.positionVBO, allocation->baseVertex * positionStride, vertexOffset * positionStride, allocation->vertexCount * positionStride);
+			copy(oldAttributeVBO, pool.attributeVBO, allocation->baseVertex * attributeStride, vertexOffset * attributeStride, allocation->vertexCount * attributeStride);
+			copy(oldEBO, pool.EBO, allocation->indexOffset, indexOffset, indexBytes);
+
+			allocation->baseVertex = GLint(vertexOffset);
+			allocation->indexOffset = indexOffset;
+		}
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	GLState::Instance().DeleteBuffers(1, &oldPositionVBO);
+	GLState::Instance().DeleteBuffers(1, &oldAttributeVBO);
+	GLState::Instance().DeleteBuffers(1, &oldEBO);
+
+	SetupVertexArrays(format);
+	CheckBudget();
+}
+
+int GeometryArena::Allocate(VertexFormat format, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+	const std::vector<unsigned int>& lodIndexCounts, const glm::vec3& quantizationOrigin, const glm::vec3& quantizationExtent)
+{
+	Pool& pool = pools[size_t(format)];
+	if (!pool.positionVBO)
+	{
+		Generate(format, pool.vertexRanges.GetCapacity(), pool.indexRanges.GetCapacity());
+		SetupVertexArrays(format);
+	}
+
+	const GLenum indexType = vertices.size() <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	const size_t indexBytes = indices.size() * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+	const size_t indexRangeBytes = (indexBytes + 3) & ~size_t(3);
+
+	size_t vertexOffset, indexOffset;
+	if (!pool.vertexRanges.Allocate(vertices.size(), vertexOffset))
+	{
+		Resize(format, std::max(2 * pool.vertexRanges.GetCapacity(), pool.vertexRanges.GetCapacity() + vertices.size()), pool.indexRanges.GetCapacity(), false);
+		pool.vertexRanges.Allocate(vertices.size(), vertexOffset);
+	}
+	if (!pool.indexRanges.Allocate(indexRangeBytes, indexOffset))
+	{
+		Resize(format, pool.vertexRanges.GetCapacity(), std::max(2 * pool.indexRanges.GetCapacity(), pool.indexRanges.GetCapacity() + indexRangeBytes), false);
+		pool.indexRanges.Allocate(indexRangeBytes, indexOffset);
+	}
+
+	// Split the interleaved vertices into the position and attribute streams, converting to the target format.
+	std::vector<unsigned char> positions(vertices.size() * PositionStride(format));
+	std::vector<unsigned char> attributes(vertices.size() * AttributeStride(format));
+	glm::vec3 inverseExtent = 1.0f / glm::max(quantizationExtent, glm::vec3(1e-20f));
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const Vertex& vertex = vertices[i];
+
+		if (format == VertexFormat::QUANTIZED)
+		{
+			glm::vec3 normalized = (vertex.Position - quantizationOrigin) * inverseExtent;
+			QuantizedPosition position = { QuantizeUnorm16(normalized.x), QuantizeUnorm16(normalized.y), QuantizeUnorm16(normalized.z), 0 };
+			memcpy(&positions[i * sizeof(QuantizedPosition)], &position, sizeof(position));
+		}
+		else
+			memcpy(&positions[i * sizeof(glm::vec3)], &vertex.Position, sizeof(glm::vec3));
+
+		if (format == VertexFormat::STANDARD)
+		{
+			StandardAttributes attribute = { vertex.Normal, vertex.TextureCoords };
+			memcpy(&attributes[i * sizeof(StandardAttributes)], &attribute, sizeof(attribute));
+		}
+		else
+		{
+			PackedAttributes attribute;
+			attribute.Normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+			attribute.TextureCoords = glm::packHalf2x16(vertex.TextureCoords);
+			memcpy(&attributes[i * sizeof(PackedAttributes)], &attribute, sizeof(attribute));
+		}
+	}
+
+	Upload(pool.positionVBO, vertexOffset * PositionStride(format), positions.data(), positions.size());
+	Upload(pool.attributeVBO, vertexOffset * AttributeStride(format), attributes.data(), attributes.size());
+	// Requests complete in order, so the allocation is resident once its indices are.
+	uint64_t uploadTicket;
+	if (indexType == GL_UNSIGNED_SHORT)
+	{
+		std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+		uploadTicket = Upload(pool.EBO, indexOffset, shortIndices.data(), indexBytes);
+	}
+	else
+		uploadTicket = Upload(pool.EBO, indexOffset, indices.data(), indexBytes);
+
+	GeometryAllocation allocation;
+	allocation.format = format;
+	allocation.indexType = indexType;
+	allocation.baseVertex = GLint(vertexOffset);
+	allocation.indexOffset = indexOffset;
+	allocation.vertexCount = (unsigned int)vertices.size();
+	allocation.indexCount = (unsigned int)indices.size();
+	allocation.live = true;
+	allocation.uploadTicket = uploadTicket;
+
+	if (lodIndexCounts.empty())
+		allocation.lodIndexCount[0] = allocation.indexCount;
+	else
+	{
+		allocation.lodCount = std::min((unsigned int)lodIndexCounts.size(), MAX_GEOMETRY_LODS);
+		unsigned int first = 0;
+		for (unsigned int i = 0; i < allocation.lodCount; ++i)
+		{
+			allocation.lodFirstIndex[i] = first;
+			allocation.lodIndexCount[i] = lodIndexCounts[i];
+			first += lodIndexCounts[i];
+		}
+	}
+
+	if (!freeAllocationIDs.empty())
+	{
+		int ID = freeAllocationIDs.back();
+		freeAllocationIDs.pop_back();
+		allocations[ID] = allocation;
+		return ID;
+	}
+	allocations.push_back(allocation);
+	return int(allocations.size() - 1);
+}
+
+void GeometryArena::Free(int allocationID)
+{
+	if (allocationID < 0 || allocationID >= int(allocations.size()) || !allocations[allocationID].live)
+		return;
+
+	GeometryAllocation& allocation = allocations[allocationID];
+	Pool& pool = pools[size_t(allocation.format)];
+	size_t indexBytes = allocation.indexCount * (allocation.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+	pool.vertexRanges.Free(allocation.baseVertex, allocation.vertexCount);
+	pool.indexRanges.Free(allocation.indexOffset, (indexBytes + 3) & ~size_t(3));
+	allocation.live = false;
+	freeAllocationIDs.push_back(allocationID);
+}
+
+const GeometryAllocation& GeometryArena::Get(int allocationID) const
+{
+	return allocations[allocationID];
+}
+
+bool GeometryArena::IsResident(int allocationID) const
+{
+	return !uploadQueue || uploadQueue->IsComplete(allocations[allocationID].uploadTicket);
+}
+
+uint64_t GeometryArena::Upload(unsigned int buffer, size_t offset, const void* data, size_t size)
+{
+	if (uploadQueue)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		return uploadQueue->UploadBuffer(buffer, offset, std::vector<unsigned char>(bytes, bytes + size));
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return 0;
+}
+
+void GeometryArena::Defragment()
+{
+	for (size_t i = 0; i < size_t(VertexFormat::COUNT); ++i)
+	{
+		if (pools[i].positionVBO)
+			Resize(VertexFormat(i), pools[i].vertexRanges.GetCapacity(), pools[i].indexRanges.GetCapacity(), true);
+	}
+}
+
+void GeometryArena::BindVertexArray(VertexFormat format)
+{
+	GLState::Instance().BindVertexArray(pools[size_t(format)].VAO);
+}
+
+void GeometryArena::BindDepthVertexArray(VertexFormat format)
+{
+	GLState::Instance().BindVertexArray(pools[size_t(format)].depthVAO);
+}
+
+size_t GeometryArena::GetUsedBytes() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < size_t(VertexFormat::COUNT); ++i)
+	{
+		if (pools[i].positionVBO)
+			bytes += pools[i].vertexRanges.GetUsed() * (PositionStride(VertexFormat(i)) + AttributeStride(VertexFormat(i))) + pools[i].indexRanges.GetUsed();
+	}
+	return bytes;
+}
+
+size_t GeometryArena::GetCapacityBytes() const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < size_t(VertexFormat::COUNT); ++i)
+	{
+		if (pools[i].positionVBO)
+			bytes += pools[i].vertexRanges.GetCapacity() * (PositionStride(VertexFormat(i)) + AttributeStride(VertexFormat(i))) + pools[i].indexRanges.GetCapacity();
+	}
+	return bytes;
+}
+
+void GeometryArena::CheckBudget() const
+{
+	if (budgetBytes > 0 && GetCapacityBytes() > budgetBytes)
+		std::cout << "WARNING::GEOMETRY_ARENA::Geometry memory (" << GetCapacityBytes() << " bytes) exceeds the budget of " << budgetBytes << " bytes." << std::endl;
+}
+
+GeometryArena::~GeometryArena()
+{
+	for (Pool& pool : pools)
+	{
+		GLState::Instance().DeleteVertexArrays(1, &pool.VAO);
+		GLState::Instance().DeleteVertexArrays(1, &pool.depthVAO);
+		GLState::Instance().DeleteBuffers(1, &pool.positionVBO);
+		GLState::Instance().DeleteBuffers(1, &pool.attributeVBO);
+		GLState::Instance().DeleteBuffers(1, &pool.EBO);
+	}
+}
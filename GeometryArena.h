@@ -0,0 +1,129 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+struct Vertex;
+class UploadQueue;
+
+// First-fit suballocator over a linear range of elements, with coalescing of freed ranges.
+class RangeAllocator
+{
+public:
+	void   Reset(size_t Capacity);
+	void   Grow(size_t newCapacity);
+	bool   Allocate(size_t size, size_t& offset);
+	void   Free(size_t offset, size_t size);
+	size_t GetCapacity() const;
+	size_t GetUsed() const;
+
+private:
+	// Offset -> size of each free range.
+	std::map<size_t, size_t> freeRanges;
+	size_t                   capacity	= 0;
+	size_t                   used		= 0;
+};
+
+// Vertex layouts the arena can store. Each format has its own buffers and vertex arrays.
+enum class VertexFormat
+{
+	// float3 position | float3 normal, float2 UV. 32 bytes.
+	STANDARD,
+	// float3 position | 2_10_10_10 normal, half2 UV. 20 bytes.
+	COMPACT,
+	// unorm16x3 position | 2_10_10_10 normal, half2 UV. 16 bytes. Positions are normalized to a per-model box
+	// which the model folds back in through its dequantization matrix.
+	QUANTIZED,
+	COUNT
+};
+
+// Levels of detail stored per allocation, including the full resolution level.
+const unsigned int MAX_GEOMETRY_LODS = 4;
+
+struct GeometryAllocation
+{
+	VertexFormat format			= VertexFormat::STANDARD;
+	GLenum       indexType		= GL_UNSIGNED_INT;
+	GLint        baseVertex		= 0;
+	// Byte offset of the first index in the format's index buffer.
+	size_t       indexOffset	= 0;
+	unsigned int vertexCount	= 0;
+	// Total over all levels of detail, which are stored back to back in the index range.
+	unsigned int indexCount		= 0;
+	bool         live			= false;
+	// Upload queue ticket of the allocation's data, 0 if it was written directly.
+	uint64_t     uploadTicket	= 0;
+
+	unsigned int lodCount							= 1;
+	// Relative to the allocation's first index.
+	unsigned int lodFirstIndex[MAX_GEOMETRY_LODS]	= {};
+	unsigned int lodIndexCount[MAX_GEOMETRY_LODS]	= {};
+};
+
+// Shared vertex and index buffers holding all static geometry, one set per vertex format. Positions and the
+// remaining attributes live in separate streams so that the depth pre-pass can fetch positions only. Meshes refer
+// to their geometry by an allocation ID and draw with glDrawElementsBaseVertex out of the shared vertex arrays.
+// Meshes with fewer than 65536 vertices store 16-bit indices.
+class GeometryArena
+{
+public:
+	GeometryArena(size_t VertexCapacity, size_t IndexCapacity);
+	~GeometryArena();
+
+	// Returns an allocation ID, or -1 on failure. indices holds all levels of detail back to back, lodIndexCounts
+	// their sizes; empty means a single level. For QUANTIZED, positions are mapped from the box starting at
+	// quantizationOrigin with size quantizationExtent to [0, 1].
+	int                       Allocate(VertexFormat format, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+								const std::vector<unsigned int>& lodIndexCounts = {},
+								const glm::vec3& quantizationOrigin = glm::vec3(0.0f), const glm::vec3& quantizationExtent = glm::vec3(1.0f));
+	void                      Free(int allocationID);
+	const GeometryAllocation& Get(int allocationID) const;
+	// Whether the allocation's data has reached its buffers. Draws of it have to be skipped until then.
+	bool                      IsResident(int allocationID) const;
+
+	// Compacts all live allocations to the start of the buffers. Allocation IDs stay valid.
+	void                      Defragment();
+
+	void                      BindVertexArray(VertexFormat format);
+	void                      BindDepthVertexArray(VertexFormat format);
+
+	size_t                    GetUsedBytes() const;
+	size_t                    GetCapacityBytes() const;
+
+	static size_t             PositionStride(VertexFormat format);
+	static size_t             AttributeStride(VertexFormat format);
+
+	// A warning is printed when geometry memory grows beyond this many bytes. 0 disables the check.
+	size_t                    budgetBytes	= 0;
+	// Streams new geometry in if set, otherwise it is written directly.
+	UploadQueue*              uploadQueue	= nullptr;
+
+private:
+	struct Pool
+	{
+		unsigned int   positionVBO		= 0;
+		unsigned int   attributeVBO		= 0;
+		unsigned int   EBO				= 0;
+		unsigned int   VAO				= 0;
+		unsigned int   depthVAO			= 0;
+		// In vertices.
+		RangeAllocator vertexRanges;
+		// In bytes, always in multiples of 4 so that both index types stay aligned.
+		RangeAllocator indexRanges;
+	};
+
+	Pool                            pools[size_t(VertexFormat::COUNT)];
+	std::vector<GeometryAllocation> allocations;
+	std::vector<int>                freeAllocationIDs;
+
+	void Generate(VertexFormat format, size_t vertexCapacity, size_t indexCapacity);
+	void Resize(VertexFormat format, size_t vertexCapacity, size_t indexCapacity, bool compact);
+	void SetupVertexArrays(VertexFormat format);
+	void CheckBudget() const;
+	// Returns the upload ticket, 0 if written directly.
+	uint64_t Upload(unsigned int buffer, size_t offset, const void* data, size_t size);
+};
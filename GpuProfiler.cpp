@@ -0,0 +1,190 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+void GpuProfiler::BeginFrame()
+{
+	if (!generated)
+	{
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+			glGenQueries(MAX_PASSES * 2, queries[i]);
+		generated = true;
+	}
+
+	// The set about to be reused was issued FRAMES_IN_FLIGHT frames ago.
+	unsigned int slot = frame % FRAMES_IN_FLIGHT;
+	ReadBack(slot);
+	records[slot].clear();
+	openPasses.clear();
+}
+
+void GpuProfiler::EndFrame()
+{
+	while (!openPasses.empty())
+		EndPass();
+	++frame;
+}
+
+void GpuProfiler::BeginPass(const std::string& name)
+{
+	unsigned int slot = frame % FRAMES_IN_FLIGHT;
+	if (records[slot].size() >= MAX_PASSES)
+	{
+		// The matching EndPass() must not close the enclosing pass.
+		openPasses.push_back(DROPPED_PASS);
+		if (!overflowWarned)
+		{
+			std::cout << "WARNING::GPU_PROFILER::More than " << MAX_PASSES << " passes in a frame, '" << name << "' and later passes are not timed." << std::endl;
+			overflowWarned = true;
+		}
+		return;
+	}
+
+	unsigned int pass = 0;
+	while (pass < passes.size() && passes[pass].name != name)
+		++pass;
+	if (pass == passes.size())
+	{
+		passes.push_back(PassHistory());
+		passes.back().name = name;
+	}
+
+	unsigned int index = (unsigned int)records[slot].size();
+	records[slot].push_back({ pass, queries[slot][index * 2], queries[slot][index * 2 + 1] });
+	openPasses.push_back(index);
+	glQueryCounter(records[slot][index].startQuery, GL_TIMESTAMP);
+}
+
+void GpuProfiler::EndPass()
+{
+	if (openPasses.empty())
+		return;
+
+	unsigned int slot = frame % FRAMES_IN_FLIGHT;
+	if (openPasses.back() != DROPPED_PASS)
+		glQueryCounter(records[slot][openPasses.back()].endQuery, GL_TIMESTAMP);
+	openPasses.pop_back();
+}
+
+void GpuProfiler::ReadBack(unsigned int slot)
+{
+	std::vector<PassRecord>& slotRecords = records[slot];
+	if (slotRecords.empty())
+		return;
+
+	// Reading a result that is not available would block until the GPU catches up.
+	bool available = true;
+	for (const PassRecord& record : slotRecords)
+	{
+		GLuint endAvailable = 0;
+		glGetQueryObjectuiv(record.endQuery, GL_QUERY_RESULT_AVAILABLE, &endAvailable);
+		available = available && endAvailable;
+	}
+	if (!available)
+	{
+		++droppedFrames;
+		return;
+	}
+
+	for (const PassRecord& record : slotRecords)
+	{
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(record.startQuery, GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(record.endQuery, GL_QUERY_RESULT, &end);
+		AddSample(record.pass, end > start ? float(double(end - start) / 1.0e6) : 0.0f);
+	}
+}
+
+void GpuProfiler::AddSample(unsigned int pass, float milliseconds)
+{
+	PassHistory& history = passes[pass];
+	if (history.samples.size() < HISTORY_SIZE)
+		history.samples.push_back(milliseconds);
+	else
+		history.samples[history.next] = milliseconds;
+	history.next = (history.next + 1) % HISTORY_SIZE;
+}
+
+std::vector<GpuPassStats> GpuProfiler::GetStats() const
+{
+	std::vector<GpuPassStats> stats;
+	std::vector<float> sorted;
+	for (const PassHistory& history : passes)
+	{
+		GpuPassStats pass;
+		pass.name = history.name;
+		pass.samples = (unsigned int)history.samples.size();
+		if (!history.samples.empty())
+		{
+			sorted = history.samples;
+			std::sort(sorted.begin(), sorted.end());
+			double sum = 0.0;
+			for (float sample : sorted)
+				sum += sample;
+
+			pass.last = history.samples[(history.next + history.samples.size() - 1) % history.samples.size()];
+			pass.min = sorted.front();
+			pass.max = sorted.back();
+			pass.average = float(sum / sorted.size());
+			pass.p99 = sorted[std::min(sorted.size() - 1, size_t(0.99 * sorted.size()))];
+		}
+		stats.push_back(pass);
+	}
+	return stats;
+}
+
+float GpuProfiler::GetLastTime(const std::string& name) const
+{
+	for (const PassHistory& history : passes)
+	{
+		if (history.name == name && !history.samples.empty())
+			return history.samples[(history.next + history.samples.size() - 1) % history.samples.size()];
+	}
+	return 0.0f;
+}
+
+void GpuProfiler::PrintReport(std::ostream& stream) const
+{
+	stream << "GPU_PROFILER::Pass times in ms over the last " << HISTORY_SIZE << " frames, " << droppedFrames << " frames dropped." << std::endl;
+	stream << std::left << std::setw(16) << "pass" << std::right << std::setw(10) << "min" << std::setw(10) << "avg"
+		<< std::setw(10) << "max" << std::setw(10) << "p99" << std::setw(10) << "samples" << std::endl;
+	stream << std::fixed << std::setprecision(3);
+	for (const GpuPassStats& pass : GetStats())
+	{
+		stream << std::left << std::setw(16) << pass.name << std::right << std::setw(10) << pass.min << std::setw(10) << pass.average
+			<< std::setw(10) << pass.max << std::setw(10) << pass.p99 << std::setw(10) << pass.samples << std::endl;
+	}
+	stream << std::defaultfloat;
+}
+
+bool GpuProfiler::WriteCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "ERROR::GPU_PROFILER::Could not write " << path << std::endl;
+		return false;
+	}
+
+	file << "pass,min_ms,avg_ms,max_ms,p99_ms,samples" << std::endl;
+	for (const GpuPassStats& pass : GetStats())
+		file << pass.name << ',' << pass.min << ',' << pass.average << ',' << pass.max << ',' << pass.p99 << ',' << pass.samples << std::endl;
+	return true;
+}
+
+unsigned int GpuProfiler::GetDroppedFrames() const
+{
+	return droppedFrames;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	if (generated)
+	{
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+			glDeleteQueries(MAX_PASSES * 2, queries[i]);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Rolling statistics of one profiled pass, in milliseconds.
+struct GpuPassStats
+{
+	std::string  name;
+	float        last		= 0.0f;
+	float        min		= 0.0f;
+	float        average	= 0.0f;
+	float        max		= 0.0f;
+	float        p99		= 0.0f;
+	unsigned int samples	= 0;
+};
+
+// GPU time per render pass from GL_TIMESTAMP query pairs. Passes may nest. Query sets are rotated over several
+// frames and only read once their results are available, so profiling never stalls the pipeline; a frame whose
+// results are still pending when its set comes around again is dropped. Timer queries are core in GL 3.3, so this
+// also works on software implementations such as llvmpipe.
+class GpuProfiler
+{
+public:
+	static const unsigned int FRAMES_IN_FLIGHT	= 3;
+	// Passes per frame past this are not timed, a warning is printed the first time.
+	static const unsigned int MAX_PASSES		= 32;
+	// Samples kept per pass for the rolling statistics.
+	static const unsigned int HISTORY_SIZE		= 300;
+
+	~GpuProfiler();
+
+	void                      BeginFrame();
+	void                      EndFrame();
+	void                      BeginPass(const std::string& name);
+	void                      EndPass();
+
+	std::vector<GpuPassStats> GetStats() const;
+	// Latest completed time of the pass in milliseconds, 0 if it has none yet.
+	float                     GetLastTime(const std::string& name) const;
+	void                      PrintReport(std::ostream& stream) const;
+	// Writes one row per pass with its rolling statistics. Returns false if the file cannot be written.
+	bool                      WriteCsv(const std::string& path) const;
+	unsigned int              GetDroppedFrames() const;
+
+private:
+	struct PassRecord
+	{
+		unsigned int pass;
+		unsigned int startQuery;
+		unsigned int endQuery;
+	};
+
+	struct PassHistory
+	{
+		std::string        name;
+		std::vector<float> samples;
+		unsigned int       next		= 0;
+	};
+
+	unsigned int             queries[FRAMES_IN_FLIGHT][MAX_PASSES * 2] = {};
+	std::vector<PassRecord>  records[FRAMES_IN_FLIGHT];
+	// Record index of each open pass, DROPPED_PASS for passes begun past MAX_PASSES.
+	std::vector<unsigned int> openPasses;
+	std::vector<PassHistory> passes;
+	unsigned int             frame			= 0;
+	unsigned int             droppedFrames	= 0;
+	bool                     generated		= false;
+	bool                     overflowWarned	= false;
+
+	static const unsigned int DROPPED_PASS	= ~0u;
+
+	void ReadBack(unsigned int slot);
+	void AddSample(unsigned int pass, float milliseconds);
+};
@@ -0,0 +1,292 @@
+#include "MaterialTable.h"
+#include "stb_image.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+MaterialTable::MaterialTable()
+{}
+
+int MaterialTable::AddMaterial(const std::string& diffusePath, const std::string& specularPath, float shininess)
+{
+	if (materials.size() >= MAX_MATERIALS)
+	{
+		std::cout << "WARNING::MATERIAL_TABLE::Material table is full, falling back to per-mesh textures." << std::endl;
+		return -1;
+	}
+
+	Material material;
+	material.diffuseImage = AddImage(diffusePath.empty() ? defaultTexturePath : diffusePath);
+	material.specularImage = specularPath.empty() ? -1 : AddImage(specularPath);
+	material.shininess = shininess;
+	materials.push_back(material);
+	return int(materials.size() - 1);
+}
+
+int MaterialTable::AddImage(const std::string& path)
+{
+	auto found = imageIndices.find(path);
+	if (found != imageIndices.end())
+		return found->second;
+
+	Image image;
+	image.path = path;
+	images.push_back(image);
+	imageIndices[path] = int(images.size() - 1);
+	return int(images.size() - 1);
+}
+
+void MaterialTable::Build(ThreadPool& threadPool)
+{
+	// Decode new images as RGBA so that only the size decides which array an image goes into.
+	std::vector<int> newImages;
+	for (int i = 0; i < int(images.size()); ++i)
+	{
+		if (!images[i].decoded)
+			newImages.push_back(i);
+	}
+	threadPool.ParallelFor((unsigned int)newImages.size(), [&](unsigned int i)
+	{
+		Image& image = images[newImages[i]];
+		int nrChannels;
+		unsigned char* data = stbi_load(image.path.c_str(), &image.width, &image.height, &nrChannels, 4);
+		if (data)
+		{
+			image.pixels.assign(data, data + size_t(image.width) * image.height * 4);
+			stbi_image_free(data);
+		}
+	});
+	for (int index : newImages)
+	{
+		Image& image = images[index];
+		if (image.pixels.empty())
+		{
+			std::cerr << "Failed to load texture from path '" << image.path << "'" << std::endl;
+			image.width = image.height = 1;
+			image.pixels.assign(4, 255);
+		}
+		image.decoded = true;
+	}
+
+	// Group images by size, most used sizes first.
+	std::map<std::pair<int, int>, std::vector<int>> groups;
+	for (int i = 0; i < int(images.size()); ++i)
+	{
+		groups[{ images[i].width, images[i].height }].push_back(i);
+	}
+	std::vector<std::vector<int>> sortedGroups;
+	for (auto& group : groups)
+	{
+		sortedGroups.push_back(group.second);
+	}
+	std::stable_sort(sortedGroups.begin(), sortedGroups.end(),
+		[](const std::vector<int>& a, const std::vector<int>& b) { return a.size() > b.size(); });
+
+	// Images that do not fit into the available arrays are resampled into the largest group when it is packed.
+	while (sortedGroups.size() > MAX_TEXTURE_ARRAYS)
+	{
+		sortedGroups[0].insert(sortedGroups[0].end(), sortedGroups.back().begin(), sortedGroups.back().end());
+		sortedGroups.pop_back();
+	}
+
+	// Groups keep the array that held their size in the previous build, so that their material indices only change
+	// when layers were added.
+	int groupArrays[MAX_TEXTURE_ARRAYS];
+	bool arrayTaken[MAX_TEXTURE_ARRAYS] = { false };
+	for (unsigned int i = 0; i < sortedGroups.size(); ++i)
+	{
+		const Image& first = images[sortedGroups[i][0]];
+		groupArrays[i] = -1;
+		for (unsigned int array = 0; array < MAX_TEXTURE_ARRAYS; ++array)
+		{
+			if (arrays[array] && !arrayTaken[array] && arraySizes[array] == glm::ivec2(first.width, first.height))
+			{
+				groupArrays[i] = int(array);
+				arrayTaken[array] = true;
+				break;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < sortedGroups.size(); ++i)
+	{
+		for (unsigned int array = 0; groupArrays[i] < 0; ++array)
+		{
+			if (!arrayTaken[array])
+			{
+				groupArrays[i] = int(array);
+				arrayTaken[array] = true;
+			}
+		}
+	}
+
+	// Arrays whose size no longer has a group are released.
+	for (unsigned int array = 0; array < MAX_TEXTURE_ARRAYS; ++array)
+	{
+		if (!arrayTaken[array] && arrays[array])
+		{
+			GLState::Instance().DeleteTextures(1, &arrays[array]);
+			arrays[array] = 0;
+			arrayImages[array].clear();
+		}
+	}
+	for (unsigned int i = 0; i < sortedGroups.size(); ++i)
+	{
+		const Image& first = images[sortedGroups[i][0]];
+		PackArray((unsigned int)groupArrays[i], sortedGroups[i], glm::ivec2(first.width, first.height));
+	}
+
+	// Upload the material table.
+	std::vector<GPUMaterial> gpuMaterials(MAX_MATERIALS);
+	for (unsigned int i = 0; i < materials.size(); ++i)
+	{
+		const Image& diffuse = images[materials[i].diffuseImage];
+		gpuMaterials[i].layers = glm::ivec4(diffuse.array, diffuse.layer, -1, -1);
+		if (materials[i].specularImage >= 0)
+		{
+			const Image& specular = images[materials[i].specularImage];
+			gpuMaterials[i].layers.z = specular.array;
+			gpuMaterials[i].layers.w = specular.layer;
+		}
+		gpuMaterials[i].parameters = glm::vec4(materials[i].shininess, 0.0f, 0.0f, 0.0f);
+	}
+
+	if (!materialBuffer)
+		glGenBuffers(1, &materialBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, gpuMaterials.size() * sizeof(GPUMaterial), gpuMaterials.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	built = true;
+	builtMaterialCount = materials.size();
+}
+
+void MaterialTable::PackArray(unsigned int array, const std::vector<int>& group, glm::ivec2 size)
+{
+	// Layers are only ever added, an array with the same images is still up to date.
+	if (arrays[array] && arrayImages[array] == group && arraySizes[array] == size)
+		return;
+
+	if (arrays[array])
+		GLState::Instance().DeleteTextures(1, &arrays[array]);
+	glGenTextures(1, &arrays[array]);
+	arrayImages[array] = group;
+	arraySizes[array] = size;
+
+	const Image* latest = &images[group[0]];
+	for (int index : group)
+	{
+		if (images[index].samplerOrder > latest->samplerOrder)
+			latest = &images[index];
+	}
+	GLState::Instance().BindTexture(GL_TEXTURE_2D_ARRAY, arrays[array]);
+	ApplySampler(latest->sampler);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size.x, size.y, GLsizei(group.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	for (unsigned int layer = 0; layer < group.size(); ++layer)
+	{
+		Image& image = images[group[layer]];
+		if (image.width == size.x && image.height == size.y)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+		else
+		{
+			std::cout << "WARNING::MATERIAL_TABLE::Resampling '" << image.path << "' to "
+				<< size.x << "x" << size.y << " to fit into a texture array." << std::endl;
+			std::vector<unsigned char> resampled = Resample(image, size.x, size.y);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, resampled.data());
+		}
+		image.array = int(array);
+		image.layer = int(layer);
+	}
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	std::cout << "Texture array " << array << " (" << size.x << "x" << size.y << ") packed with " << group.size() << " layers." << std::endl;
+}
+
+void MaterialTable::SetSamplerOptions(int material, const TextureRenderOption& option)
+{
+	if (material < 0 || material >= int(materials.size()))
+		return;
+
+	for (int index : { materials[material].diffuseImage, materials[material].specularImage })
+	{
+		if (index < 0)
+			continue;
+		Image& image = images[index];
+		image.sampler = option;
+		image.samplerOrder = ++samplerCount;
+		// Images added since the last build get the options when they are packed.
+		if (image.array >= 0 && arrays[image.array])
+		{
+			GLState::Instance().BindTexture(GL_TEXTURE_2D_ARRAY, arrays[image.array]);
+			ApplySampler(option);
+		}
+	}
+}
+
+void MaterialTable::ApplySampler(const TextureRenderOption& option)
+{
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, option.horizontalWrapMode);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, option.verticalWrapMode);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, option.minFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, option.magFilter);
+}
+
+bool MaterialTable::NeedsBuild() const
+{
+	return materials.size() != builtMaterialCount;
+}
+
+void MaterialTable::Bind() const
+{
+	for (unsigned int i = 0; i < MAX_TEXTURE_ARRAYS; ++i)
+	{
+		GLState::Instance().BindTexture(FIRST_TEXTURE_UNIT + i, GL_TEXTURE_2D_ARRAY, arrays[i]);
+	}
+	GLState::Instance().BindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_DATA_BINDING, materialBuffer);
+}
+
+bool MaterialTable::IsBuilt() const
+{
+	return built;
+}
+
+std::vector<unsigned char> MaterialTable::Resample(const Image& image, int width, int height)
+{
+	// Bilinear resampling of RGBA8 pixels.
+	std::vector<unsigned char> resampled(size_t(width) * height * 4);
+	for (int y = 0; y < height; ++y)
+	{
+		float sourceY = std::max(0.0f, (y + 0.5f) * image.height / height - 0.5f);
+		int y0 = std::min(int(sourceY), image.height - 1);
+		int y1 = std::min(y0 + 1, image.height - 1);
+		float fy = sourceY - y0;
+		for (int x = 0; x < width; ++x)
+		{
+			float sourceX = std::max(0.0f, (x + 0.5f) * image.width / width - 0.5f);
+			int x0 = std::min(int(sourceX), image.width - 1);
+			int x1 = std::min(x0 + 1, image.width - 1);
+			float fx = sourceX - x0;
+			for (int c = 0; c < 4; ++c)
+			{
+				float top = image.pixels[(size_t(y0) * image.width + x0) * 4 + c] * (1.0f - fx) + image.pixels[(size_t(y0) * image.width + x1) * 4 + c] * fx;
+				float bottom = image.pixels[(size_t(y1) * image.width + x0) * 4 + c] * (1.0f - fx) + image.pixels[(size_t(y1) * image.width + x1) * 4 + c] * fx;
+				resampled[(size_t(y) * width + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+			}
+		}
+	}
+	return resampled;
+}
+
+MaterialTable::~MaterialTable()
+{
+	for (unsigned int i = 0; i < MAX_TEXTURE_ARRAYS; ++i)
+	{
+		if (arrays[i])
+			GLState::Instance().DeleteTextures(1, &arrays[i]);
+	}
+	if (materialBuffer)
+		GLState::Instance().DeleteBuffers(1, &materialBuffer);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Texture2D.h"
+#include "ThreadPool.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+// Packs material textures of equal size into GL_TEXTURE_2D_ARRAY layers and keeps a table of material parameters
+// in a uniform buffer. Meshes using the table only differ by a material index, so no textures are rebound between
+// their draws.
+class MaterialTable
+{
+public:
+	static const unsigned int MAX_TEXTURE_ARRAYS		= 4;
+	static const unsigned int MAX_MATERIALS				= 256;
+	// Texture units 0.. are used by the per-mesh texture path, so arrays start higher up.
+	static const unsigned int FIRST_TEXTURE_UNIT		= 8;
+	static const unsigned int MATERIAL_DATA_BINDING		= 2;
+
+	MaterialTable();
+	~MaterialTable();
+
+	// Registers a material. An empty diffuse path selects the default texture, an empty specular path means none.
+	// Returns the material index, or -1 if the table is full.
+	int  AddMaterial(const std::string& diffusePath, const std::string& specularPath, float shininess);
+	// Decodes newly registered images on the thread pool, packs them into texture arrays and uploads the material
+	// table. Can be called again after materials were added: material indices stay the same and only arrays whose
+	// layers changed are repacked.
+	void Build(ThreadPool& threadPool);
+	// Sets wrap modes and filters of the arrays holding the material's images. Arrays are shared, so the other
+	// materials in them change too. When an array is repacked, the options set last for any of its images win.
+	void SetSamplerOptions(int material, const TextureRenderOption& option);
+	// Whether materials were added since the last Build().
+	bool NeedsBuild() const;
+	// Binds the texture arrays and the material buffer.
+	void Bind() const;
+	bool IsBuilt() const;
+
+	std::string defaultTexturePath = "textures/white.jpg";
+
+private:
+	struct Image
+	{
+		std::string                path;
+		int                        width	= 0;
+		int                        height	= 0;
+		// Decoded RGBA pixels at their own size, kept so that arrays can be repacked without decoding again.
+		std::vector<unsigned char> pixels;
+		bool                       decoded	= false;
+		int                        array	= -1;
+		int                        layer	= -1;
+		TextureRenderOption        sampler;
+		// When the sampler options were set, 0 if they never were.
+		unsigned int               samplerOrder	= 0;
+	};
+
+	struct Material
+	{
+		int   diffuseImage	= -1;
+		int   specularImage	= -1;
+		float shininess		= 64.0f;
+	};
+
+	// std140 layout of one entry of the MaterialData block.
+	struct GPUMaterial
+	{
+		// x: diffuse array, y: diffuse layer, z: specular array, w: specular layer. -1 means none.
+		glm::ivec4 layers;
+		// x: shininess.
+		glm::vec4  parameters;
+	};
+
+	std::vector<Image>         images;
+	std::map<std::string, int> imageIndices;
+	std::vector<Material>      materials;
+
+	// Array names and the images in their layers, unused arrays are 0.
+	unsigned int               arrays[MAX_TEXTURE_ARRAYS]	= { 0 };
+	std::vector<int>           arrayImages[MAX_TEXTURE_ARRAYS];
+	glm::ivec2                 arraySizes[MAX_TEXTURE_ARRAYS];
+	unsigned int               materialBuffer				= 0;
+	bool                       built						= false;
+	size_t                     builtMaterialCount			= 0;
+	unsigned int               samplerCount					= 0;
+
+	int  AddImage(const std::string& path);
+	void PackArray(unsigned int array, const std::vector<int>& group, glm::ivec2 size);
+	static void ApplySampler(const TextureRenderOption& option);
+	static std::vector<unsigned char> Resample(const Image& image, int width, int height);
+};
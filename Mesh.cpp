@@ -2,56 +2,73 @@
 #include "Shader.h"
 #include "glad/glad.h"
 #include "Engine.h"
+#include "GLState.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 
-Mesh::Mesh(std::vector<Vertex> Vertices,std::vector<unsigned int> Indices, std::vector<Texture2D> Textures)
+Mesh::Mesh(std::vector<Vertex> Vertices,std::vector<unsigned int> Indices, std::vector<MeshTexture> Textures)
 	: vertices{ Vertices }, indices{ Indices }, textures{ Textures }
 {
-	setupMesh();
-
-	for (int i = 0; i < textures.size(); ++i)
+	if (!vertices.empty())
 	{
-		textures[i].textureID = i;
+		boundsMin = boundsMax = vertices[0].Position;
+		for (const Vertex& vertex : vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex.Position);
+			boundsMax = glm::max(boundsMax, vertex.Position);
+		}
 	}
 }
 
-void Mesh::setupMesh()
+void Mesh::upload(VertexFormat format, const glm::vec3& quantizationOrigin, const glm::vec3& quantizationExtent)
 {
-	// Generate VAO, VBO and EBO.
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	glBindVertexArray(VAO);
-
-	// Load VBO data.
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	// Load EBO data.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-	// Vertex Positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-
-	// Vertex Normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Vertex::Normal));
+	// Suballocate from the shared vertex and index buffers instead of creating buffers per mesh.
+	if (lodIndices.empty())
+	{
+		allocationID = Engine::Instance().geometryArena.Allocate(format, vertices, indices, {}, quantizationOrigin, quantizationExtent);
+		return;
+	}
 
-	// Vertex Texture Coordinates
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Vertex::TextureCoords));
+	// All levels share the vertices and go into one index range.
+	std::vector<unsigned int> allIndices = indices;
+	std::vector<unsigned int> lodIndexCounts = { (unsigned int)indices.size() };
+	for (const std::vector<unsigned int>& lod : lodIndices)
+	{
+		allIndices.insert(allIndices.end(), lod.begin(), lod.end());
+		lodIndexCounts.push_back((unsigned int)lod.size());
+	}
+	allocationID = Engine::Instance().geometryArena.Allocate(format, vertices, allIndices, lodIndexCounts, quantizationOrigin, quantizationExtent);
+}
 
-	// Unbind VAO.
-	glBindVertexArray(0);
+bool Mesh::fitsPackedFormat() const
+{
+	// A half float has 10 mantissa bits, so its step is 1/64 between 16 and 32 and finer below. Tiling coordinates
+	// past 16 would snap to visibly coarse steps.
+	for (const Vertex& vertex : vertices)
+	{
+		if (glm::abs(vertex.TextureCoords.x) > 16.0f || glm::abs(vertex.TextureCoords.y) > 16.0f)
+			return false;
+	}
+	return true;
 }
 
-void Mesh::Draw(Shader& shader)
+void Mesh::Draw(Shader& shader, unsigned int lod)
 {
 	shader.use();
+
+	if (Engine::Instance().TEXTURE_ARRAYS)
+	{
+		shader.setInt("materialIndex", materialIndex);
+		// Texture arrays are bound once per frame, the material index is all that changes.
+		if (materialIndex >= 0)
+		{
+			DrawGeometry(lod);
+			return;
+		}
+	}
+
 	unsigned int diffuseNumber = 1;
 	unsigned int specularNumber = 1;
 	for (unsigned int i = 0; i < textures.size(); ++i)
@@ -70,34 +87,45 @@ void Mesh::Draw(Shader& shader)
 			break;
 		}
 		shader.setuInt(("material." + name + number).c_str(), i);
-		textures[i].use();
+		// Textures are shared between meshes, so the unit is picked here rather than stored with the texture. Until a
+		// streamed texture has data, the default one stands in for it.
+		const Texture2D& texture = textures[i].texture.Get();
+		unsigned int textureID = texture.isReady() ? texture.ID : Engine::Instance().defaultTexture->ID;
+		GLState::Instance().BindTexture(i, GL_TEXTURE_2D, textureID);
 	}
 
 	if (textures.size() == 0)
 	{
 		// Use default texture if the mesh contains no textures.
 		shader.setuInt("material.diffuse1", 0);
-		Engine::Instance().defaultTexture.use();
+		GLState::Instance().BindTexture(0, GL_TEXTURE_2D, Engine::Instance().defaultTexture->ID);
 	}
 
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, GLint(indices.size()), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
-	// This sets the active texture to default so that in future we get nothing unexpected.
-	glActiveTexture(GL_TEXTURE0);
+	DrawGeometry(lod);
 }
 
-const unsigned int& Mesh::getVAO() const
+void Mesh::DrawGeometry(unsigned int lod) const
 {
-	return VAO;
+	GeometryArena& arena = Engine::Instance().geometryArena;
+	if (!arena.IsResident(allocationID))
+		return;
+	const GeometryAllocation& allocation = arena.Get(allocationID);
+	// Meshes of one model share a format, so this is filtered after the first mesh.
+	arena.BindVertexArray(allocation.format);
+	lod = std::min(lod, allocation.lodCount - 1);
+	size_t indexSize = allocation.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(allocation.lodIndexCount[lod]), allocation.indexType,
+		(void*)(allocation.indexOffset + allocation.lodFirstIndex[lod] * indexSize), allocation.baseVertex);
+	GLState::Instance().CountDraw(1, allocation.lodIndexCount[lod] / 3);
 }
 
-const unsigned int& Mesh::getVBO() const
+int Mesh::getAllocationID() const
 {
-	return VBO;
+	return allocationID;
 }
 
-const unsigned int& Mesh::getEBO() const
+void Mesh::release()
 {
-	return EBO;
+	Engine::Instance().geometryArena.Free(allocationID);
+	allocationID = -1;
 }
\ No newline at end of file
@@ -4,7 +4,8 @@
 #include <string>
 #include <vector>
 #include <string>
-#include "Texture2D.h"
+#include "TextureCache.h"
+#include "GeometryArena.h"
 
 class Shader;
 
@@ -15,24 +16,45 @@ struct Vertex
 	glm::vec2 TextureCoords;
 };
 
+// A texture of the engine's texture cache and the material slot a mesh samples it as.
+struct MeshTexture
+{
+	TextureHandle texture;
+	TextureType   type		= TextureType::DIFFUSE;
+};
+
 class Mesh
 {
 public:
 	std::vector<Vertex>			vertices;
 	std::vector<unsigned int>	indices;
-	std::vector<Texture2D>		textures;
+	// Simplified index lists over the same vertices, coarsest last. Does not include the full resolution level.
+	std::vector<std::vector<unsigned int>> lodIndices;
+	std::vector<MeshTexture>	textures;
+	// Entry in the engine's material table, or -1 if the mesh binds its own textures.
+	int							materialIndex = -1;
 
-	Mesh(std::vector<Vertex> Vertices, std::vector<unsigned int> Indices, std::vector<Texture2D> Textures);
-	
-	void Draw(Shader& shader);
+	// Object-space bounding box.
+	glm::vec3					boundsMin	= glm::vec3(0.0f);
+	glm::vec3					boundsMax	= glm::vec3(0.0f);
 
-	const unsigned int& getVAO() const;
-	const unsigned int& getVBO() const;
-	const unsigned int& getEBO() const;
+	Mesh(std::vector<Vertex> Vertices, std::vector<unsigned int> Indices, std::vector<MeshTexture> Textures);
 
-private:
-	unsigned int VAO, VBO, EBO;
+	// Copies the geometry into the engine's geometry arena. For QUANTIZED, positions are stored relative to the
+	// given box.
+	void upload(VertexFormat format, const glm::vec3& quantizationOrigin = glm::vec3(0.0f), const glm::vec3& quantizationExtent = glm::vec3(1.0f));
+	// Whether the mesh's attributes survive packing to half-float texture coordinates.
+	bool fitsPackedFormat() const;
 
-	void setupMesh();
+	// Levels of detail the mesh does not have fall back to its coarsest level.
+	void Draw(Shader& shader, unsigned int lod = 0);
+	void DrawGeometry(unsigned int lod = 0) const;
+
+	int  getAllocationID() const;
+	void release();
+
+private:
+	// Location of the mesh's vertices and indices in the engine's geometry arena.
+	int allocationID = -1;
 };
 
@@ -0,0 +1,431 @@
+#include "MeshCache.h"
+#include "Model.h"
+#include "Engine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint32_t CACHE_MAGIC		= 0x48534D43; // "CMSH"
+	const uint32_t CACHE_VERSION	= 1;
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t settings;
+		uint32_t meshCount;
+		uint64_t sourceHash;
+		uint32_t isTransparent;
+		uint32_t isCullable;
+		uint32_t lodCount;
+		uint32_t occluderPositionCount;
+		uint32_t occluderIndexCount;
+		uint32_t reserved;
+		float    boundsMin[3];
+		float    boundsMax[3];
+		uint32_t importStats[3];
+		uint32_t optimizedStats[3];
+	};
+
+	struct CacheMeshHeader
+	{
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t lodLevelCount;
+		uint32_t materialPresent;
+		uint32_t diffuseCount;
+		uint32_t specularCount;
+		float    shininess;
+		float    boundsMin[3];
+		float    boundsMax[3];
+		uint32_t reserved;
+	};
+
+	// Read-only view of a whole file.
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& path)
+		{
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+				return;
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (!mapping)
+				return;
+			data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (data)
+				size = size_t(fileSize.QuadPart);
+#else
+			descriptor = open(path.c_str(), O_RDONLY);
+			if (descriptor < 0)
+				return;
+			struct stat status;
+			if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+				return;
+			void* view = mmap(NULL, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (view == MAP_FAILED)
+				return;
+			data = (const unsigned char*)view;
+			size = size_t(status.st_size);
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (data)
+				UnmapViewOfFile(data);
+			if (mapping)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+#else
+			if (data)
+				munmap((void*)data, size);
+			if (descriptor >= 0)
+				close(descriptor);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		void operator=(const MappedFile&) = delete;
+
+		const unsigned char* data	= nullptr;
+		size_t               size	= 0;
+
+	private:
+#ifdef _WIN32
+		HANDLE file		= INVALID_HANDLE_VALUE;
+		HANDLE mapping	= NULL;
+#else
+		int    descriptor	= -1;
+#endif
+	};
+
+	// Bounds checked cursor over a mapped file.
+	class Reader
+	{
+	public:
+		Reader(const unsigned char* Data, size_t Size) : data{ Data }, size{ Size } {}
+
+		bool Read(void* destination, size_t bytes)
+		{
+			if (bytes > size - offset)
+				return false;
+			if (bytes > 0)
+				std::memcpy(destination, data + offset, bytes);
+			offset += bytes;
+			return true;
+		}
+
+		template<typename T>
+		bool ReadVector(std::vector<T>& values, size_t count)
+		{
+			if (count > (size - offset) / sizeof(T))
+				return false;
+			values.resize(count);
+			return Read(values.data(), count * sizeof(T));
+		}
+
+		size_t Remaining() const
+		{
+			return size - offset;
+		}
+
+		bool ReadString(std::string& value)
+		{
+			uint32_t length;
+			if (!Read(&length, sizeof(length)) || length > size - offset)
+				return false;
+			value.assign((const char*)data + offset, length);
+			offset += length;
+			return true;
+		}
+
+	private:
+		const unsigned char* data;
+		size_t               size;
+		size_t               offset	= 0;
+	};
+
+	template<typename T>
+	void WriteVector(std::ofstream& file, const std::vector<T>& values)
+	{
+		file.write((const char*)values.data(), std::streamsize(values.size() * sizeof(T)));
+	}
+
+	void WriteString(std::ofstream& file, const std::string& value)
+	{
+		uint32_t length = (uint32_t)value.size();
+		file.write((const char*)&length, sizeof(length));
+		file.write(value.data(), length);
+	}
+
+	void HashBytes(std::ifstream& file, uint64_t& hash)
+	{
+		char buffer[64 * 1024];
+		while (file)
+		{
+			file.read(buffer, sizeof(buffer));
+			std::streamsize count = file.gcount();
+			for (std::streamsize i = 0; i < count; ++i)
+			{
+				hash ^= (unsigned char)buffer[i];
+				hash *= 1099511628211ull;
+			}
+		}
+	}
+}
+
+std::string MeshCache::GetCachePath(const std::string& sourcePath)
+{
+	return Engine::GetCachePath(sourcePath, ".cmesh");
+}
+
+uint32_t MeshCache::SettingsKey()
+{
+	Engine& engine = Engine::Instance();
+	// The import flags are a bit field of their own, the engine settings go into the top bits.
+	return (Model::IMPORT_FLAGS & 0x0FFFFFFFu) ^ uint32_t(engine.OPTIMIZE_MESHES) << 28 ^ uint32_t(engine.GENERATE_LODS) << 29
+		^ uint32_t(engine.OCCLUSION_CULLING) << 30;
+}
+
+bool MeshCache::SourceHash(const std::string& sourcePath, uint64_t& hash)
+{
+	std::ifstream source(sourcePath, std::ios::binary);
+	if (!source)
+		return false;
+	hash = 14695981039346656037ull;
+	HashBytes(source, hash);
+
+	// Materials of .obj files live in separate libraries, which are most likely next to the model.
+	std::filesystem::path path(sourcePath);
+	if (path.extension() != ".obj")
+		return true;
+	std::vector<std::filesystem::path> libraries;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(path.parent_path(), error))
+	{
+		if (entry.path().extension() == ".mtl")
+			libraries.push_back(entry.path());
+	}
+	// Directory order is unspecified.
+	std::sort(libraries.begin(), libraries.end());
+	for (const std::filesystem::path& library : libraries)
+	{
+		std::ifstream file(library, std::ios::binary);
+		HashBytes(file, hash);
+	}
+	return true;
+}
+
+bool MeshCache::Load(const std::string& sourcePath, const std::string& cachePath, Model& model)
+{
+	MappedFile mapped(cachePath);
+	if (!mapped.data)
+		return false;
+	Reader reader(mapped.data, mapped.size);
+
+	CacheHeader header;
+	uint64_t sourceHash;
+	if (!reader.Read(&header, sizeof(header)) || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION
+		|| header.settings != SettingsKey() || !SourceHash(sourcePath, sourceHash) || header.sourceHash != sourceHash)
+		return false;
+
+	auto fail = [&model, &cachePath]()
+	{
+		std::cout << "WARNING::MESH_CACHE::" << cachePath << " is truncated, importing the source." << std::endl;
+		model.meshes.clear();
+		model.meshMaterials.clear();
+		model.occluderPositions.clear();
+		model.occluderIndices.clear();
+		return false;
+	};
+
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		CacheMeshHeader meshHeader;
+		if (!reader.Read(&meshHeader, sizeof(meshHeader)))
+			return fail();
+
+		if (uint64_t(meshHeader.diffuseCount) + meshHeader.specularCount > reader.Remaining() / sizeof(uint32_t))
+			return fail();
+		Model::MeshMaterial material;
+		material.present = meshHeader.materialPresent != 0;
+		material.shininess = meshHeader.shininess;
+		material.diffusePaths.resize(meshHeader.diffuseCount);
+		material.specularPaths.resize(meshHeader.specularCount);
+		for (std::string& texturePath : material.diffusePaths)
+		{
+			if (!reader.ReadString(texturePath))
+				return fail();
+		}
+		for (std::string& texturePath : material.specularPaths)
+		{
+			if (!reader.ReadString(texturePath))
+				return fail();
+		}
+
+		// Built empty so the constructor does not walk the vertices for bounds, which are stored.
+		model.meshes.push_back(Mesh({}, {}, {}));
+		Mesh& mesh = model.meshes.back();
+		mesh.boundsMin = glm::vec3(meshHeader.boundsMin[0], meshHeader.boundsMin[1], meshHeader.boundsMin[2]);
+		mesh.boundsMax = glm::vec3(meshHeader.boundsMax[0], meshHeader.boundsMax[1], meshHeader.boundsMax[2]);
+
+		std::vector<uint32_t> lodIndexCounts;
+		if (!reader.ReadVector(lodIndexCounts, meshHeader.lodLevelCount) || !reader.ReadVector(mesh.vertices, meshHeader.vertexCount)
+			|| !reader.ReadVector(mesh.indices, meshHeader.indexCount))
+			return fail();
+		mesh.lodIndices.resize(meshHeader.lodLevelCount);
+		for (uint32_t level = 0; level < meshHeader.lodLevelCount; ++level)
+		{
+			if (!reader.ReadVector(mesh.lodIndices[level], lodIndexCounts[level]))
+				return fail();
+		}
+		model.meshMaterials.push_back(std::move(material));
+	}
+
+	if (!reader.ReadVector(model.occluderPositions, header.occluderPositionCount)
+		|| !reader.ReadVector(model.occluderIndices, header.occluderIndexCount))
+		return fail();
+
+	model.isTransparent = header.isTransparent != 0;
+	model.isCullable = header.isCullable != 0;
+	model.lodCount = header.lodCount;
+	model.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	model.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	model.importStats.vertexCount = header.importStats[0];
+	model.importStats.triangleCount = header.importStats[1];
+	model.importStats.transformedCount = header.importStats[2];
+	model.optimizedStats.vertexCount = header.optimizedStats[0];
+	model.optimizedStats.triangleCount = header.optimizedStats[1];
+	model.optimizedStats.transformedCount = header.optimizedStats[2];
+	return true;
+}
+
+bool MeshCache::ReadBounds(const std::string& cachePath, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	std::ifstream file(cachePath, std::ios::binary);
+	CacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CACHE_MAGIC
+		|| header.version != CACHE_VERSION || header.settings != SettingsKey())
+		return false;
+	boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	return true;
+}
+
+bool MeshCache::Write(const std::string& sourcePath, const std::string& cachePath, const Model& model)
+{
+	CacheHeader header = {};
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.settings = SettingsKey();
+	if (!SourceHash(sourcePath, header.sourceHash))
+		return false;
+	header.meshCount = (uint32_t)model.meshes.size();
+	header.isTransparent = model.isTransparent;
+	header.isCullable = model.isCullable;
+	header.lodCount = model.lodCount;
+	header.occluderPositionCount = (uint32_t)model.occluderPositions.size();
+	header.occluderIndexCount = (uint32_t)model.occluderIndices.size();
+	for (int i = 0; i < 3; ++i)
+	{
+		header.boundsMin[i] = model.boundsMin[i];
+		header.boundsMax[i] = model.boundsMax[i];
+	}
+	header.importStats[0] = model.importStats.vertexCount;
+	header.importStats[1] = model.importStats.triangleCount;
+	header.importStats[2] = model.importStats.transformedCount;
+	header.optimizedStats[0] = model.optimizedStats.vertexCount;
+	header.optimizedStats[1] = model.optimizedStats.triangleCount;
+	header.optimizedStats[2] = model.optimizedStats.transformedCount;
+
+	// Written under a temporary name, so a model loading at the same time never maps a partial file.
+	std::string temporaryPath = cachePath + ".tmp";
+	if (!Engine::CreateCacheFolders(cachePath))
+		return false;
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::MESH_CACHE::Could not write " << cachePath << std::endl;
+			return false;
+		}
+		file.write((const char*)&header, sizeof(header));
+
+		for (size_t i = 0; i < model.meshes.size(); ++i)
+		{
+			const Mesh& mesh = model.meshes[i];
+			const Model::MeshMaterial& material = model.meshMaterials[i];
+
+			CacheMeshHeader meshHeader = {};
+			meshHeader.vertexCount = (uint32_t)mesh.vertices.size();
+			meshHeader.indexCount = (uint32_t)mesh.indices.size();
+			meshHeader.lodLevelCount = (uint32_t)mesh.lodIndices.size();
+			meshHeader.materialPresent = material.present;
+			meshHeader.diffuseCount = (uint32_t)material.diffusePaths.size();
+			meshHeader.specularCount = (uint32_t)material.specularPaths.size();
+			meshHeader.shininess = material.shininess;
+			for (int j = 0; j < 3; ++j)
+			{
+				meshHeader.boundsMin[j] = mesh.boundsMin[j];
+				meshHeader.boundsMax[j] = mesh.boundsMax[j];
+			}
+			file.write((const char*)&meshHeader, sizeof(meshHeader));
+			for (const std::string& texturePath : material.diffusePaths)
+				WriteString(file, texturePath);
+			for (const std::string& texturePath : material.specularPaths)
+				WriteString(file, texturePath);
+
+			std::vector<uint32_t> lodIndexCounts;
+			for (const std::vector<unsigned int>& lod : mesh.lodIndices)
+				lodIndexCounts.push_back((uint32_t)lod.size());
+			WriteVector(file, lodIndexCounts);
+			WriteVector(file, mesh.vertices);
+			WriteVector(file, mesh.indices);
+			for (const std::vector<unsigned int>& lod : mesh.lodIndices)
+				WriteVector(file, lod);
+		}
+
+		WriteVector(file, model.occluderPositions);
+		WriteVector(file, model.occluderIndices);
+		if (!file)
+		{
+			std::cout << "ERROR::MESH_CACHE::Could not write " << cachePath << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		std::cout << "ERROR::MESH_CACHE::Could not write " << cachePath << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <glm/glm.hpp>
+
+class Model;
+
+// Stores what Model::prepare() builds from a model file, so later runs skip Assimp and the mesh processing that
+// follows it. The file is "<source>.cmesh" under Engine::CACHE_DIRECTORY and holds the model's bounds, cullability,
+// level of detail count and occluder, then per mesh its bounds, material texture paths and the vertex, index and
+// level of detail blocks, stored as in memory. It is keyed by a hash of the source, and of the material libraries next to it,
+// and by the import settings, so stale files are rebuilt. Files are memory mapped, so blocks are copied straight out
+// of the mapping.
+class MeshCache
+{
+public:
+	static std::string GetCachePath(const std::string& sourcePath);
+	// Fills an empty model from the cache. Returns false, leaving the model empty, if the file is missing or stale.
+	static bool        Load(const std::string& sourcePath, const std::string& cachePath, Model& model);
+	static bool        Write(const std::string& sourcePath, const std::string& cachePath, const Model& model);
+	// Reads the model's bounds from the header alone. The source is not hashed, so the bounds may be stale, which is
+	// good enough to size a placeholder.
+	static bool        ReadBounds(const std::string& cachePath, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+private:
+	// Import settings the cached data depends on.
+	static uint32_t    SettingsKey();
+	// FNV-1a over the source file and, for .obj files, the .mtl files in its folder.
+	static bool        SourceHash(const std::string& sourcePath, uint64_t& hash);
+};
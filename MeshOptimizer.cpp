@@ -0,0 +1,332 @@
+#include "MeshOptimizer.h"
+#include "Mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	struct VertexHash
+	{
+		size_t operator()(const Vertex& vertex) const
+		{
+			// FNV-1a over the raw bytes, welding only merges exact copies.
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+			size_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < sizeof(Vertex); ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+
+	struct VertexEqual
+	{
+		bool operator()(const Vertex& a, const Vertex& b) const
+		{
+			return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+		}
+	};
+
+	// FIFO cache simulation. A vertex is cached if it entered the cache less than CACHE_SIZE misses ago.
+	struct CacheSimulator
+	{
+		std::vector<unsigned int> cacheTime;
+		unsigned int              time		= MeshOptimizer::CACHE_SIZE + 1;
+
+		explicit CacheSimulator(size_t vertexCount) : cacheTime(vertexCount, 0) {}
+
+		// Returns the number of misses for one triangle.
+		unsigned int Process(const unsigned int* triangle)
+		{
+			unsigned int misses = 0;
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				unsigned int v = triangle[k];
+				if (time - cacheTime[v] > MeshOptimizer::CACHE_SIZE)
+				{
+					cacheTime[v] = time++;
+					++misses;
+				}
+			}
+			return misses;
+		}
+
+		void Flush()
+		{
+			time += MeshOptimizer::CACHE_SIZE + 1;
+		}
+	};
+}
+
+void MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	// Only triangle lists are handled.
+	if (indices.empty() || indices.size() % 3 != 0)
+		return;
+
+	WeldVertices(vertices, indices);
+	std::vector<unsigned int> clusters = OptimizeVertexCache(indices, vertices.size());
+	OptimizeOverdraw(vertices, indices, clusters);
+	OptimizeVertexFetch(vertices, indices);
+}
+
+void MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+	unique.reserve(vertices.size());
+
+	std::vector<unsigned int> remap(vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto result = unique.emplace(vertices[i], (unsigned int)welded.size());
+		if (result.second)
+			welded.push_back(vertices[i]);
+		remap[i] = result.first->second;
+	}
+
+	for (unsigned int& index : indices)
+		index = remap[index];
+	vertices.swap(welded);
+}
+
+std::vector<unsigned int> MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	std::vector<unsigned int> clusters;
+
+	// Vertex to triangle adjacency.
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (unsigned int index : indices)
+		++liveTriangles[index];
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		for (unsigned int k = 0; k < 3; ++k)
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+	}
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+
+	unsigned int time = CACHE_SIZE + 1;
+	unsigned int cursor = 0;
+	int fanning = 0;
+	clusters.push_back(0);
+
+	while (fanning >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex.
+		candidates.clear();
+		for (unsigned int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				unsigned int v = indices[t * 3 + k];
+				result.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+				if (time - cacheTime[v] > CACHE_SIZE)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// Prefer the candidate that stays in the cache longest while all its triangles are emitted.
+		int next = -1;
+		int bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= CACHE_SIZE)
+				priority = int(time - cacheTime[v]);
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = int(v);
+			}
+		}
+
+		if (next < 0)
+		{
+			// Dead end, continue from a recently used vertex or else the next vertex in order.
+			while (!deadEnds.empty() && next < 0)
+			{
+				unsigned int v = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[v] > 0)
+					next = int(v);
+			}
+			while (cursor < vertexCount && next < 0)
+			{
+				if (liveTriangles[cursor] > 0)
+				{
+					next = int(cursor);
+					// Jumping to an unrelated vertex flushes the cache, a free place to start a new cluster.
+					if (clusters.back() != result.size() / 3)
+						clusters.push_back((unsigned int)(result.size() / 3));
+				}
+				++cursor;
+			}
+		}
+
+		fanning = next;
+	}
+
+	indices.swap(result);
+	if (clusters.back() >= indices.size() / 3)
+		clusters.pop_back();
+	return clusters;
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	const std::vector<unsigned int>& clusters, float threshold)
+{
+	const unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+	if (clusters.empty() || triangleCount == 0)
+		return;
+
+	// Soft boundaries: split a cluster wherever the misses so far are close to the cluster's average.
+	std::vector<unsigned int> boundaries;
+	CacheSimulator cache(vertices.size());
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		unsigned int start = clusters[c];
+		unsigned int end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+
+		cache.Flush();
+		unsigned int clusterMisses = 0;
+		for (unsigned int t = start; t < end; ++t)
+			clusterMisses += cache.Process(&indices[t * 3]);
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		cache.Flush();
+		unsigned int misses = 0;
+		unsigned int softStart = start;
+		for (unsigned int t = start; t < end; ++t)
+		{
+			misses += cache.Process(&indices[t * 3]);
+			if (t + 1 == end || float(misses) / float(t - softStart + 1) <= clusterThreshold)
+			{
+				boundaries.push_back(softStart);
+				softStart = t + 1;
+				misses = 0;
+				cache.Flush();
+			}
+		}
+	}
+
+	// Area weighted centroid of the whole mesh.
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (unsigned int t = 0; t < triangleCount; ++t)
+	{
+		const glm::vec3& a = vertices[indices[t * 3 + 0]].Position;
+		const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+		const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+		float area = glm::length(glm::cross(b - a, c - a));
+		meshCentroid += (a + b + c) * (area / 3.0f);
+		meshArea += area;
+	}
+	meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+	// Clusters that face away from the centre are likely to occlude the others, so they go first.
+	std::vector<std::pair<float, unsigned int>> order(boundaries.size());
+	for (size_t c = 0; c < boundaries.size(); ++c)
+	{
+		unsigned int start = boundaries[c];
+		unsigned int end = (c + 1 < boundaries.size()) ? boundaries[c + 1] : triangleCount;
+
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (unsigned int t = start; t < end; ++t)
+		{
+			const glm::vec3& a = vertices[indices[t * 3 + 0]].Position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+			glm::vec3 cross = glm::cross(b - a, c - a);
+			float triangleArea = glm::length(cross);
+			centroid += (a + b + c) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		centroid = area > 0.0f ? centroid / area : centroid;
+		float normalLength = glm::length(normal);
+		normal = normalLength > 0.0f ? normal / normalLength : normal;
+
+		order[c] = { glm::dot(centroid - meshCentroid, normal), (unsigned int)c };
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (const auto& entry : order)
+	{
+		unsigned int start = boundaries[entry.second];
+		unsigned int end = (entry.second + 1 < boundaries.size()) ? boundaries[entry.second + 1] : triangleCount;
+		result.insert(result.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+	}
+	indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)ordered.size();
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(ordered);
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	VertexCacheStats stats;
+	stats.vertexCount = (unsigned int)vertexCount;
+	stats.triangleCount = (unsigned int)(indices.size() / 3);
+
+	CacheSimulator cache(vertexCount);
+	for (size_t t = 0; t < stats.triangleCount; ++t)
+		stats.transformedCount += cache.Process(&indices[t * 3]);
+
+	if (stats.triangleCount > 0)
+		stats.ACMR = float(stats.transformedCount) / float(stats.triangleCount);
+	if (stats.vertexCount > 0)
+		stats.ATVR = float(stats.transformedCount) / float(stats.vertexCount);
+	return stats;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+struct Vertex;
+
+// Post-transform vertex cache statistics of an index buffer.
+struct VertexCacheStats
+{
+	// Average cache miss ratio: transformed vertices per triangle. 0.5 is the ideal for large regular meshes, 3 the worst.
+	float        ACMR				= 0.0f;
+	// Average transform to vertex ratio: transformed vertices per unique vertex. 1 is the ideal.
+	float        ATVR				= 0.0f;
+	unsigned int vertexCount		= 0;
+	unsigned int triangleCount		= 0;
+	unsigned int transformedCount	= 0;
+};
+
+// Import-time mesh optimization. Operates on triangle lists in place.
+class MeshOptimizer
+{
+public:
+	// FIFO cache size used for both the optimization and the statistics.
+	static const unsigned int CACHE_SIZE = 16;
+
+	// Runs all stages in order: weld, vertex cache, overdraw, vertex fetch.
+	static void Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// Merges bit-identical vertices.
+	static void WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+	// Reorders triangles for the post-transform cache (Tipsify). Returns the first triangle of every cluster that starts
+	// after a cache flush, which are the points where triangle order can change without hurting the cache.
+	static std::vector<unsigned int> OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+	// Splits the clusters further where their cache efficiency allows it and orders them so that outward facing
+	// clusters are drawn first. threshold is the ACMR increase the split may cost, relative to the unsplit clusters.
+	static void OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+		const std::vector<unsigned int>& clusters, float threshold = 1.05f);
+	// Reorders vertices by first use and drops unreferenced ones.
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount);
+};
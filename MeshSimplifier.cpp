@@ -0,0 +1,245 @@
+#include "MeshSimplifier.h"
+#include "Mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	// Symmetric 4x4 matrix, upper triangle only.
+	struct Quadric
+	{
+		double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+
+		static Quadric FromPlane(const glm::dvec3& n, double d, double weight)
+		{
+			Quadric q;
+			q.a00 = n.x * n.x * weight; q.a01 = n.x * n.y * weight; q.a02 = n.x * n.z * weight; q.a03 = n.x * d * weight;
+			q.a11 = n.y * n.y * weight; q.a12 = n.y * n.z * weight; q.a13 = n.y * d * weight;
+			q.a22 = n.z * n.z * weight; q.a23 = n.z * d * weight;
+			q.a33 = d * d * weight;
+			return q;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+		}
+
+		// Sum of squared distances to all accumulated planes.
+		double Evaluate(const glm::dvec3& p) const
+		{
+			double result = a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x
+				+ a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y
+				+ a22 * p.z * p.z + 2.0 * a23 * p.z
+				+ a33;
+			return result > 0.0 ? result : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double       cost;
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+			return size_t(bits[0]) * 73856093u ^ size_t(bits[1]) * 19349663u ^ size_t(bits[2]) * 83492791u;
+		}
+	};
+
+	uint64_t EdgeKey(unsigned int a, unsigned int b)
+	{
+		return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+	}
+}
+
+std::vector<unsigned int> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+	size_t targetIndexCount)
+{
+	std::vector<unsigned int> result = indices;
+	if (indices.size() % 3 != 0 || result.size() <= targetIndexCount)
+		return result;
+
+	const size_t vertexCount = vertices.size();
+
+	// Wedges with the same position form one topological vertex, identified by the first of them.
+	std::vector<unsigned int> canonical(vertexCount);
+	std::vector<unsigned int> wedgeCount(vertexCount, 0);
+	{
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> positions;
+		positions.reserve(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; ++v)
+		{
+			canonical[v] = positions.emplace(vertices[v].Position, v).first->second;
+			++wedgeCount[canonical[v]];
+		}
+	}
+
+	// Seam vertices and vertices on open borders are locked.
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<uint64_t, unsigned int> edgeUses;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (unsigned int k = 0; k < 3; ++k)
+				++edgeUses[EdgeKey(canonical[result[i + k]], canonical[result[i + (k + 1) % 3]])];
+		}
+		for (const auto& edge : edgeUses)
+		{
+			if (edge.second == 1)
+			{
+				locked[(unsigned int)(edge.first >> 32)] = true;
+				locked[(unsigned int)(edge.first & 0xFFFFFFFF)] = true;
+			}
+		}
+		for (unsigned int v = 0; v < vertexCount; ++v)
+		{
+			if (wedgeCount[canonical[v]] > 1)
+				locked[canonical[v]] = true;
+		}
+	}
+
+	// Area weighted plane quadrics, accumulated per topological vertex.
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		glm::dvec3 a(vertices[result[i + 0]].Position);
+		glm::dvec3 b(vertices[result[i + 1]].Position);
+		glm::dvec3 c(vertices[result[i + 2]].Position);
+		glm::dvec3 normal = glm::cross(b - a, c - a);
+		double area = glm::length(normal);
+		if (area <= 0.0)
+			continue;
+		normal /= area;
+
+		Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, a), area);
+		for (unsigned int k = 0; k < 3; ++k)
+			quadrics[canonical[result[i + k]]].Add(q);
+	}
+
+	std::vector<unsigned int> adjacencyOffsets, adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+
+	// Each pass collapses a set of independent edges, cheapest first.
+	while (result.size() > targetIndexCount)
+	{
+		const size_t triangleCount = result.size() / 3;
+
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (unsigned int index : result)
+			++adjacencyOffsets[canonical[index] + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(result.size());
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i)
+			adjacency[fill[canonical[result[i]]]++] = (unsigned int)(i / 3);
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				unsigned int from = result[i + k];
+				unsigned int to = result[i + (k + 1) % 3];
+				if (locked[canonical[from]])
+					continue;
+				collapses.push_back({ from, to, quadrics[canonical[from]].Evaluate(glm::dvec3(vertices[to].Position)) });
+			}
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (unsigned int v = 0; v < vertexCount; ++v)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		// A collapse removes about two triangles.
+		size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+		size_t trianglesRemoved = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (trianglesRemoved >= trianglesToRemove)
+				break;
+
+			unsigned int from = canonical[collapse.from];
+			unsigned int to = canonical[collapse.to];
+			if (touched[from] || touched[to])
+				continue;
+
+			// Reject collapses that flip or degenerate a remaining triangle.
+			bool valid = true;
+			unsigned int removed = 0;
+			glm::vec3 target = vertices[collapse.to].Position;
+			for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && valid; ++a)
+			{
+				const unsigned int* triangle = &result[adjacency[a] * 3];
+				if (canonical[triangle[0]] == to || canonical[triangle[1]] == to || canonical[triangle[2]] == to)
+				{
+					++removed;
+					continue;
+				}
+
+				glm::vec3 p[3], q[3];
+				for (unsigned int k = 0; k < 3; ++k)
+				{
+					p[k] = vertices[triangle[k]].Position;
+					q[k] = canonical[triangle[k]] == from ? target : p[k];
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+					valid = false;
+			}
+			if (!valid)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[to].Add(quadrics[from]);
+			trianglesRemoved += removed;
+
+			// Neighbouring triangles change shape, they are checked again next pass.
+			for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a)
+			{
+				for (unsigned int k = 0; k < 3; ++k)
+					touched[canonical[result[adjacency[a] * 3 + k]]] = true;
+			}
+		}
+		if (trianglesRemoved == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that became degenerate.
+		size_t write = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			unsigned int a = remap[result[t * 3 + 0]];
+			unsigned int b = remap[result[t * 3 + 1]];
+			unsigned int c = remap[result[t * 3 + 2]];
+			if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	return result;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+struct Vertex;
+
+// Quadric error edge collapse simplification for generating levels of detail.
+// The simplified index buffer references the original vertices, so every level of a mesh shares one vertex buffer.
+// Vertices on open borders and on attribute seams are never moved.
+class MeshSimplifier
+{
+public:
+	// Collapses edges until the triangle list has at most targetIndexCount indices or no valid collapse is left.
+	static std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		size_t targetIndexCount);
+};
@@ -1,37 +1,246 @@
 #include "Model.h"
 #include "Shader.h"
+#include "Engine.h"
+#include "GLState.h"
+#include "MeshCache.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
+#include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include <glad/glad.h>
 #include "stb_image.h"
 
 
-void Model::Draw(Shader& shader)
+void Model::Draw(Shader& shader, unsigned int lod)
 {
+	if (placeholder)
+	{
+		placeholder->Draw(shader);
+		return;
+	}
 	for (unsigned int i = 0; i < meshes.size(); ++i)
 	{
-		meshes[i].Draw(shader);
+		meshes[i].Draw(shader, lod);
 	}
 }
 
-void Model::loadModel(const std::string& path)
+void Model::DrawGeometry(unsigned int lod)
 {
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	if (placeholder)
+	{
+		placeholder->DrawGeometry();
+		return;
+	}
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		meshes[i].DrawGeometry(lod);
+	}
+}
 
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+void Model::DrawMesh(Shader& shader, unsigned int meshIndex, unsigned int lod)
+{
+	meshes[meshIndex].Draw(shader, lod);
+}
+
+void Model::DrawDepth(unsigned int lod)
+{
+	if (placeholder)
 	{
-		std::cout << "ERROR::ASSIMP::MODEL::NAME::" << name << "::" << importer.GetErrorString() << std::endl;
+		placeholder->DrawDepth();
 		return;
 	}
 
+	// The depth pass needs no per-mesh state, so the whole model goes out in one call per index type.
+	GeometryArena& arena = Engine::Instance().geometryArena;
+	for (GLenum indexType : { GL_UNSIGNED_SHORT, GL_UNSIGNED_INT })
+	{
+		multiDrawCounts.clear();
+		multiDrawOffsets.clear();
+		multiDrawBaseVertices.clear();
+		for (unsigned int i = 0; i < meshes.size(); ++i)
+		{
+			const GeometryAllocation& allocation = arena.Get(meshes[i].getAllocationID());
+			if (allocation.indexType != indexType || !arena.IsResident(meshes[i].getAllocationID()))
+				continue;
+			unsigned int meshLod = std::min(lod, allocation.lodCount - 1);
+			size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+			multiDrawCounts.push_back(GLsizei(allocation.lodIndexCount[meshLod]));
+			multiDrawOffsets.push_back((void*)(allocation.indexOffset + allocation.lodFirstIndex[meshLod] * indexSize));
+			multiDrawBaseVertices.push_back(allocation.baseVertex);
+		}
+		if (multiDrawCounts.empty())
+			continue;
+
+		arena.BindDepthVertexArray(vertexFormat);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, multiDrawCounts.data(), indexType, multiDrawOffsets.data(),
+			GLsizei(multiDrawCounts.size()), multiDrawBaseVertices.data());
+
+		unsigned long long indices = 0;
+		for (GLsizei count : multiDrawCounts)
+			indices += count;
+		GLState::Instance().CountDraw(1, indices / 3);
+	}
+}
+
+const unsigned int Model::IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+bool Model::prepare(const std::string& path)
+{
 	directory = path.substr(0, path.find_last_of('/'));
 
+	std::string cachePath = MeshCache::GetCachePath(path);
+	fromMeshCache = Engine::Instance().MESH_CACHE && MeshCache::Load(path, cachePath, *this);
+	if (!fromMeshCache)
+	{
+		if (!importFile(path))
+			return false;
+		if (Engine::Instance().MESH_CACHE)
+			MeshCache::Write(path, cachePath, *this);
+	}
+
+	if (lodCount > 1)
+	{
+		std::vector<size_t> lodTriangles(lodCount, 0);
+		for (const Mesh& mesh : meshes)
+		{
+			for (unsigned int i = 0; i < lodCount; ++i)
+			{
+				// Same fallback to the coarsest level as at draw time.
+				unsigned int level = std::min(i, (unsigned int)mesh.lodIndices.size());
+				lodTriangles[i] += (level == 0 ? mesh.indices.size() : mesh.lodIndices[level - 1].size()) / 3;
+			}
+		}
+		std::cout << "The model '" << name << "' has " << lodCount << " levels of detail with";
+		for (unsigned int i = 0; i < lodCount; ++i)
+			std::cout << (i == 0 ? " " : "/") << lodTriangles[i];
+		std::cout << " triangles." << std::endl;
+	}
+
+	// Cook the textures now so the GL phase only reads cooked files.
+	for (const MeshMaterial& material : meshMaterials)
+	{
+		for (const std::string& texturePath : material.diffusePaths)
+			TextureCache::Prepare(texturePath);
+		for (const std::string& texturePath : material.specularPaths)
+			TextureCache::Prepare(texturePath);
+	}
+	return true;
+}
+
+bool Model::importFile(const std::string& path)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP::MODEL::NAME::" << name << "::" << importer.GetErrorString() << std::endl;
+		return false;
+	}
+
 	processNode(scene->mRootNode, scene);
 
-	// Determine cullability.
+	if (Engine::Instance().OPTIMIZE_MESHES)
+		reportImportStats();
+
+	for (const Mesh& mesh : meshes)
+		lodCount = std::max(lodCount, (unsigned int)mesh.lodIndices.size() + 1);
+
+	if (Engine::Instance().OCCLUSION_CULLING)
+		buildOccluder();
+
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		boundsMin = (i == 0) ? meshes[i].boundsMin : glm::min(boundsMin, meshes[i].boundsMin);
+		boundsMax = (i == 0) ? meshes[i].boundsMax : glm::max(boundsMax, meshes[i].boundsMax);
+	}
+
+	determineCullability();
+	return true;
+}
+
+void Model::upload()
+{
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		const MeshMaterial& material = meshMaterials[i];
+		if (!material.present)
+			continue;
+
+		if (useMaterialTable)
+		{
+			meshes[i].materialIndex = Engine::Instance().materialTable.AddMaterial(
+				material.diffusePaths.empty() ? std::string() : material.diffusePaths[0],
+				material.specularPaths.empty() ? std::string() : material.specularPaths[0], material.shininess);
+		}
+		if (meshes[i].materialIndex < 0)
+		{
+			loadMaterialTextures(meshes[i], material.diffusePaths, TextureType::DIFFUSE);
+			loadMaterialTextures(meshes[i], material.specularPaths, TextureType::SPECULAR);
+		}
+	}
+	meshMaterials.clear();
+
+	uploadMeshes();
+}
+
+void Model::adopt(Model& prepared)
+{
+	meshes.swap(prepared.meshes);
+	meshMaterials.swap(prepared.meshMaterials);
+	occluderPositions.swap(prepared.occluderPositions);
+	occluderIndices.swap(prepared.occluderIndices);
+	directory = prepared.directory;
+	isTransparent = prepared.isTransparent;
+	isCullable = prepared.isCullable;
+	fromMeshCache = prepared.fromMeshCache;
+	boundsMin = prepared.boundsMin;
+	boundsMax = prepared.boundsMax;
+	lodCount = prepared.lodCount;
+	importStats = prepared.importStats;
+	optimizedStats = prepared.optimizedStats;
+	placeholder = nullptr;
+	ownedPlaceholder.reset();
+}
+
+std::unique_ptr<Model> Model::createBox(const std::string& Name, const glm::vec3& min, const glm::vec3& max)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	const glm::vec3 normals[] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+	for (const glm::vec3& normal : normals)
+	{
+		// u x v = normal, so the corners below wind counter-clockwise seen from outside.
+		glm::vec3 u(normal.y, normal.z, normal.x);
+		glm::vec3 v = glm::cross(normal, u);
+		unsigned int first = (unsigned int)vertices.size();
+		const glm::vec2 corners[] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+		for (const glm::vec2& corner : corners)
+		{
+			Vertex vertex;
+			glm::vec3 unit = normal + corner.x * u + corner.y * v;
+			vertex.Position = min + (unit * 0.5f + 0.5f) * (max - min);
+			vertex.Normal = normal;
+			vertex.TextureCoords = corner * 0.5f + 0.5f;
+			vertices.push_back(vertex);
+		}
+		for (unsigned int index : { 0u, 1u, 2u, 0u, 2u, 3u })
+			indices.push_back(first + index);
+	}
+
+	std::unique_ptr<Model> box = std::make_unique<Model>("", Name, false, false);
+	box->meshes.push_back(Mesh(vertices, indices, {}));
+	box->meshMaterials.push_back(MeshMaterial());
+	box->boundsMin = min;
+	box->boundsMax = max;
+	box->upload();
+	return box;
+}
+
+void Model::determineCullability()
+{
 	if (meshes.size() == 1)
 	{
 		// If the model has more than one mesh, it is cullable.
@@ -74,6 +283,69 @@ void Model::loadModel(const std::string& path)
 	std::cout << "The model '" << name << "' is cullable." << std::endl;
 }
 
+void Model::reportImportStats() const
+{
+	auto ratio = [](unsigned int a, unsigned int b) { return b > 0 ? float(a) / float(b) : 0.0f; };
+	std::cout << "The model '" << name << "' was optimized: "
+		<< importStats.vertexCount << " -> " << optimizedStats.vertexCount << " vertices, "
+		<< "ACMR " << ratio(importStats.transformedCount, importStats.triangleCount) << " -> " << ratio(optimizedStats.transformedCount, optimizedStats.triangleCount) << ", "
+		<< "ATVR " << ratio(importStats.transformedCount, importStats.vertexCount) << " -> " << ratio(optimizedStats.transformedCount, optimizedStats.vertexCount) << "." << std::endl;
+}
+
+void Model::buildOccluder()
+{
+	const size_t maxTrianglesPerMesh = 256;
+
+	for (const Mesh& mesh : meshes)
+	{
+		// Start from the coarsest level of detail and simplify further if it is still too dense.
+		const std::vector<unsigned int>& coarsest = mesh.lodIndices.empty() ? mesh.indices : mesh.lodIndices.back();
+		std::vector<unsigned int> proxy = coarsest.size() / 3 > maxTrianglesPerMesh
+			? MeshSimplifier::Simplify(mesh.vertices, coarsest, maxTrianglesPerMesh * 3) : coarsest;
+
+		// Keep only the positions the proxy uses.
+		std::vector<unsigned int> remap(mesh.vertices.size(), 0xFFFFFFFF);
+		for (unsigned int index : proxy)
+		{
+			if (remap[index] == 0xFFFFFFFF)
+			{
+				remap[index] = (unsigned int)occluderPositions.size();
+				occluderPositions.push_back(mesh.vertices[index].Position);
+			}
+			occluderIndices.push_back(remap[index]);
+		}
+	}
+}
+
+void Model::uploadMeshes()
+{
+	vertexFormat = Engine::Instance().VERTEX_FORMAT;
+	if (vertexFormat == VertexFormat::QUANTIZED && !quantizable)
+		vertexFormat = VertexFormat::COMPACT;
+	if (vertexFormat != VertexFormat::STANDARD)
+	{
+		for (const Mesh& mesh : meshes)
+		{
+			if (!mesh.fitsPackedFormat())
+			{
+				std::cout << "WARNING::MODEL::NAME::" << name << "::Texture coordinates exceed the packed vertex format, using the standard format." << std::endl;
+				vertexFormat = VertexFormat::STANDARD;
+				break;
+			}
+		}
+	}
+
+	// All meshes are quantized to the model's box so they share one dequantization matrix.
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+	if (vertexFormat == VertexFormat::QUANTIZED)
+		dequantization = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), extent);
+
+	for (Mesh& mesh : meshes)
+	{
+		mesh.upload(vertexFormat, boundsMin, extent);
+	}
+}
+
 void Model::processNode(aiNode* node, const aiScene* scene)
 {
 	// Process all the node's meshes (if any)
@@ -93,7 +365,6 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 {
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
-	std::vector<Texture2D> textures;
 
 	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
 	{
@@ -135,60 +406,109 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 			indices.push_back(face.mIndices[j]);
 		}
 	}
-	// Process material
+	// Process material. Textures are loaded and material table entries added in the GL phase.
+	MeshMaterial material;
 	if (mesh->mMaterialIndex >= 0)
+		material = readMaterial(scene->mMaterials[mesh->mMaterialIndex]);
+	meshMaterials.push_back(material);
+
+	if (Engine::Instance().OPTIMIZE_MESHES)
 	{
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture2D> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::DIFFUSE);
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		
-		std::vector<Texture2D> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::SPECULAR);
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		auto accumulate = [](VertexCacheStats& total, const VertexCacheStats& stats)
+		{
+			total.vertexCount += stats.vertexCount;
+			total.triangleCount += stats.triangleCount;
+			total.transformedCount += stats.transformedCount;
+		};
+		accumulate(importStats, MeshOptimizer::AnalyzeVertexCache(indices, vertices.size()));
+		MeshOptimizer::Optimize(vertices, indices);
+		accumulate(optimizedStats, MeshOptimizer::AnalyzeVertexCache(indices, vertices.size()));
 	}
 
-	return Mesh(vertices, indices, textures);
+	Mesh result(vertices, indices, {});
+	if (Engine::Instance().GENERATE_LODS)
+		generateLods(result);
+	return result;
 }
 
-std::vector<Texture2D> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType engineType)
+void Model::generateLods(Mesh& mesh)
 {
-	std::vector<Texture2D> textures;
-	for (unsigned int i = 0; i < mat->GetTextureCount(type); ++i)
+	// Small meshes are not worth the extra index memory.
+	const size_t minimumTriangles = 256;
+	const float lodRatios[MAX_GEOMETRY_LODS - 1] = { 0.5f, 0.25f, 0.125f };
+
+	size_t triangleCount = mesh.indices.size() / 3;
+	if (triangleCount < minimumTriangles)
+		return;
+
+	// Each level is simplified from the previous one.
+	for (float ratio : lodRatios)
 	{
-		aiString path;
-		mat->GetTexture(type, i, &path);
+		const std::vector<unsigned int>& previous = mesh.lodIndices.empty() ? mesh.indices : mesh.lodIndices.back();
+		std::vector<unsigned int> lod = MeshSimplifier::Simplify(mesh.vertices, previous, size_t(triangleCount * ratio) * 3);
+		// Stop once the simplifier runs out of collapses, mostly on meshes made of seams and borders.
+		if (lod.empty() || lod.size() > previous.size() * 9 / 10)
+			break;
 
-		bool skip = false;
-		for (unsigned int j = 0; j < texturesLoaded.size(); ++j)
-		{
-			if (std::strcmp(texturesLoaded[j].path.data(), path.C_Str()) == 0)
-			{
-				textures.push_back(texturesLoaded[j]);
-				skip = true;
-				break;
-			}
-		}
+		MeshOptimizer::OptimizeVertexCache(lod, mesh.vertices.size());
+		mesh.lodIndices.push_back(std::move(lod));
+	}
+}
 
-		if (!skip)
-		{
-			Texture2D texture;
-			TextureInfo info;
-			texture.load(directory + '/' + std::string(path.C_Str()), info);
-			isTransparent = true;
-			texture.type = engineType;
-			texture.path = path.C_Str();
-			textures.push_back(texture);
-			texturesLoaded.push_back(texture);
-		}
+Model::MeshMaterial Model::readMaterial(aiMaterial* mat)
+{
+	MeshMaterial material;
+	material.present = true;
+	aiString path;
+	for (unsigned int i = 0; i < mat->GetTextureCount(aiTextureType_DIFFUSE); ++i)
+	{
+		if (mat->GetTexture(aiTextureType_DIFFUSE, i, &path) == AI_SUCCESS)
+			material.diffusePaths.push_back(directory + '/' + std::string(path.C_Str()));
+	}
+	for (unsigned int i = 0; i < mat->GetTextureCount(aiTextureType_SPECULAR); ++i)
+	{
+		if (mat->GetTexture(aiTextureType_SPECULAR, i, &path) == AI_SUCCESS)
+			material.specularPaths.push_back(directory + '/' + std::string(path.C_Str()));
+	}
+
+	// Textured models are drawn as transparent, however their textures end up being bound.
+	if (!material.diffusePaths.empty() || !material.specularPaths.empty())
+		isTransparent = true;
+
+	if (mat->Get(AI_MATKEY_SHININESS, material.shininess) != AI_SUCCESS || material.shininess <= 0.0f)
+		material.shininess = 64.0f;
+	return material;
+}
+
+void Model::loadMaterialTextures(Mesh& mesh, const std::vector<std::string>& paths, TextureType engineType)
+{
+	for (const std::string& path : paths)
+	{
+		// The engine's cache shares textures between meshes and between models.
+		MeshTexture texture;
+		TextureInfo info;
+		texture.texture = Engine::Instance().textureCache.Load(path, info);
+		texture.type = engineType;
+		if (texture.texture.IsValid())
+			mesh.textures.push_back(texture);
 	}
-	return textures;
+}
+
+const std::vector<Mesh>& Model::getMeshes() const
+{
+	return meshes;
 }
 
 void Model::ApplyOptionToAllTextures(TextureRenderOption option)
 {
 	for (Mesh& mesh : meshes)
 	{
-		for (Texture2D& texture : mesh.textures)
+		// Meshes using the material table sample its arrays instead of their own textures.
+		if (mesh.materialIndex >= 0)
+			Engine::Instance().materialTable.SetSamplerOptions(mesh.materialIndex, option);
+		for (MeshTexture& meshTexture : mesh.textures)
 		{
+			Texture2D& texture = meshTexture.texture.Get();
 			texture.setHorizontalWrapMode(option.horizontalWrapMode);
 			texture.setVerticalWrapMode(option.verticalWrapMode);
 			texture.setMinFilter(option.minFilter);
@@ -197,11 +517,11 @@ void Model::ApplyOptionToAllTextures(TextureRenderOption option)
 	}
 }
 
-void Model::ApplyTexture(Texture2D texture)
+void Model::ApplyTexture(const TextureHandle& texture, TextureType type)
 {
 	for (Mesh& mesh : meshes)
 	{
-		mesh.textures.push_back(texture);
+		mesh.textures.push_back({ texture, type });
 	}
 }
 
@@ -210,12 +530,6 @@ Model::~Model()
 {
 	for (int i = 0; i < meshes.size(); ++i)
 	{
-		glDeleteVertexArrays(1, &(meshes[i].getVAO()));
-		glDeleteBuffers(1, &(meshes[i].getVBO()));
-		glDeleteBuffers(1, &(meshes[i].getEBO()));
-	}
-	for (int i = 0; i < texturesLoaded.size(); ++i)
-	{
-		glDeleteTextures(1, &(texturesLoaded[i].ID));
+		meshes[i].release();
 	}
 }
\ No newline at end of file
@@ -1,44 +1,113 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <assimp/scene.h>
 
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 
 class Shader;
-struct TextureRenderOption;
 
 class Model
 {
 public:
 
-	Model(const std::string& path, const std::string& Name) : name{ Name } { loadModel(path); }
-	void Draw(Shader& shader);
+	// Models using the material table have their textures packed into the engine's texture arrays. Models drawn
+	// without a model matrix must not be quantized. An empty path leaves loading to prepare() and upload().
+	Model(const std::string& path, const std::string& Name, bool UseMaterialTable = false, bool Quantizable = true)
+		: name{ Name }, useMaterialTable{ UseMaterialTable }, quantizable{ Quantizable } { if (!path.empty() && prepare(path)) upload(); }
+
+	// CPU phase of loading: imports the file, processes its meshes and cooks its textures. Makes no GL calls, so
+	// models can be prepared in parallel on worker threads.
+	bool prepare(const std::string& path);
+	// GL phase of loading: loads the textures, adds the materials to the material table and uploads the meshes.
+	// Context thread only.
+	void upload();
+	// Takes over what prepare() built in another model, for models in use while they load. Call upload() after.
+	void adopt(Model& prepared);
+	// Axis-aligned box with flat shaded faces and no textures, for placeholders. Context thread only.
+	static std::unique_ptr<Model> createBox(const std::string& Name, const glm::vec3& min, const glm::vec3& max);
+	void Draw(Shader& shader, unsigned int lod = 0);
+	void DrawMesh(Shader& shader, unsigned int meshIndex, unsigned int lod = 0);
+	void DrawDepth(unsigned int lod = 0);
+	// Draws all meshes without binding any textures.
+	void DrawGeometry(unsigned int lod = 0);
 	~Model();
 
+	// Options apply to the shared textures, so every model using them sees the change.
 	void ApplyOptionToAllTextures(TextureRenderOption option);
-	void ApplyTexture(Texture2D texture);
+	void ApplyTexture(const TextureHandle& texture, TextureType type = TextureType::DIFFUSE);
 
 	bool        isTransparent = false;
 	bool        isCullable    = true;
+	// Whether prepare() read the model from the mesh cache instead of importing it.
+	bool        fromMeshCache = false;
+	// Drawn instead of the model while it is loading. Either the engine's shared box or ownedPlaceholder.
+	Model*      placeholder   = nullptr;
+	// Box sized to the model's cached bounds, dropped once the model is loaded.
+	std::unique_ptr<Model> ownedPlaceholder;
 	std::string name;
 
+	// Object-space bounding box of all meshes.
+	glm::vec3   boundsMin     = glm::vec3(0.0f);
+	glm::vec3   boundsMax     = glm::vec3(0.0f);
+
+	// Vertex layout of all meshes. Quantized positions are turned back into object space by the dequantization
+	// matrix, which is the identity for the other formats.
+	VertexFormat vertexFormat   = VertexFormat::STANDARD;
+	glm::mat4    dequantization = glm::mat4(1.0f);
+
+	// Number of levels of detail of the most detailed mesh. Meshes with fewer levels draw their coarsest one.
+	unsigned int lodCount       = 1;
+
+	// Low-poly stand-in rasterized by the CPU occlusion culler. Empty if the model is not an occluder.
+	std::vector<glm::vec3>    occluderPositions;
+	std::vector<unsigned int> occluderIndices;
+
+	const std::vector<Mesh>& getMeshes() const;
+
 private:
+	friend class MeshCache;
+
+	// Assimp post-processing steps applied on import.
+	static const unsigned int IMPORT_FLAGS;
+
+	// Material of a mesh as read from the file, until upload() resolves it.
+	struct MeshMaterial
+	{
+		bool                     present	= false;
+		std::vector<std::string> diffusePaths;
+		std::vector<std::string> specularPaths;
+		float                    shininess	= 64.0f;
+	};
+
 	std::vector<Mesh>      meshes;
+	// One per mesh, between prepare() and upload().
+	std::vector<MeshMaterial> meshMaterials;
 	std::string            directory;
-	std::vector<Texture2D> texturesLoaded;
+	bool                   useMaterialTable;
+	bool                   quantizable;
+
+	// Vertex cache statistics of all meshes before and after import-time optimization.
+	VertexCacheStats       importStats;
+	VertexCacheStats       optimizedStats;
+
+	// Scratch arrays for submitting all meshes with one multi-draw call.
+	std::vector<GLsizei>   multiDrawCounts;
+	std::vector<void*>     multiDrawOffsets;
+	std::vector<GLint>     multiDrawBaseVertices;
 
-	void loadModel(const std::string& path);
+	bool importFile(const std::string& path);
+	void determineCullability();
+	void reportImportStats() const;
+	void generateLods(Mesh& mesh);
+	void buildOccluder();
+	void uploadMeshes();
 	void processNode(aiNode* node, const aiScene* scene);
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-	std::vector<Texture2D> loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType engineType);
-};
-
-struct TextureRenderOption
-{
-	GLenum horizontalWrapMode = GL_REPEAT;
-	GLenum verticalWrapMode	  = GL_REPEAT;
-	GLenum minFilter		  = GL_LINEAR_MIPMAP_LINEAR;
-	GLenum magFilter		  = GL_LINEAR;
+	MeshMaterial readMaterial(aiMaterial* mat);
+	void loadMaterialTextures(Mesh& mesh, const std::vector<std::string>& paths, TextureType engineType);
 };
@@ -0,0 +1,266 @@
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Clip space w below this counts as touching the near plane.
+	const float MIN_W = 1e-4f;
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& ViewProjection)
+{
+	viewProjection = ViewProjection;
+	triangles.clear();
+	occludees.clear();
+	results.clear();
+}
+
+void OcclusionCuller::AddOccluder(const glm::mat4& model, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+{
+	glm::mat4 mvp = viewProjection * model;
+
+	thread_local std::vector<glm::vec4> clip;
+	clip.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i)
+		clip[i] = mvp * glm::vec4(positions[i], 1.0f);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		ScreenTriangle triangle;
+		bool valid = true;
+		for (unsigned int k = 0; k < 3 && valid; ++k)
+		{
+			const glm::vec4& c = clip[indices[i + k]];
+			if (c.w < MIN_W || c.z < -c.w)
+			{
+				valid = false;
+				break;
+			}
+			float inverseW = 1.0f / c.w;
+			triangle.v[k] = glm::vec3((c.x * inverseW * 0.5f + 0.5f) * WIDTH, (c.y * inverseW * 0.5f + 0.5f) * HEIGHT, c.z * inverseW);
+		}
+		if (!valid)
+			continue;
+
+		triangle.minY = std::min(triangle.v[0].y, std::min(triangle.v[1].y, triangle.v[2].y));
+		triangle.maxY = std::max(triangle.v[0].y, std::max(triangle.v[1].y, triangle.v[2].y));
+		if (triangle.maxY < 0.0f || triangle.minY >= float(HEIGHT))
+			continue;
+		triangles.push_back(triangle);
+	}
+}
+
+unsigned int OcclusionCuller::AddOccludee(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	occludees.push_back({ model, boundsMin, boundsMax });
+	return (unsigned int)(occludees.size() - 1);
+}
+
+void OcclusionCuller::Cull(ThreadPool& threadPool)
+{
+	// Tile rows own disjoint parts of the depth buffer, so they rasterize without synchronization.
+	threadPool.ParallelFor(TILES_Y, [this](unsigned int tileRow) { RasterizeTileRow(tileRow); });
+
+	const unsigned int batchSize = 64;
+	results.resize(occludees.size());
+	threadPool.ParallelFor((unsigned int)((occludees.size() + batchSize - 1) / batchSize), [this, batchSize](unsigned int batch)
+	{
+		size_t end = std::min(occludees.size(), size_t(batch + 1) * batchSize);
+		for (size_t i = size_t(batch) * batchSize; i < end; ++i)
+			results[i] = TestOccludee(occludees[i]);
+	});
+}
+
+void OcclusionCuller::RasterizeTileRow(unsigned int tileRow)
+{
+	int rowStart = int(tileRow * TILE_HEIGHT);
+	int rowEnd = rowStart + int(TILE_HEIGHT);
+	std::fill(depth.begin() + rowStart * WIDTH, depth.begin() + rowEnd * WIDTH, 1.0f);
+
+	for (const ScreenTriangle& triangle : triangles)
+	{
+		if (triangle.maxY >= float(rowStart) && triangle.minY < float(rowEnd))
+			RasterizeTriangle(triangle, rowStart, rowEnd);
+	}
+
+	for (unsigned int tileX = 0; tileX < TILES_X; ++tileX)
+	{
+		float maxDepth = 0.0f;
+		for (int y = rowStart; y < rowEnd; ++y)
+		{
+			const float* row = &depth[y * WIDTH + tileX * TILE_WIDTH];
+			for (unsigned int x = 0; x < TILE_WIDTH; ++x)
+				maxDepth = std::max(maxDepth, row[x]);
+		}
+		tileMaxDepth[tileRow * TILES_X + tileX] = maxDepth;
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& triangle, int rowStart, int rowEnd)
+{
+	glm::vec3 v0 = triangle.v[0], v1 = triangle.v[1], v2 = triangle.v[2];
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (std::fabs(area) < 1e-8f)
+		return;
+	if (area < 0.0f)
+	{
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	// Edge functions A * x + B * y + C, non-negative inside. C is always taken relative to the same endpoint, so a shared
+	// edge evaluates to exactly opposite values in its two triangles and no pixel along it is missed.
+	float A[3], B[3], C[3];
+	const glm::vec3* edges[3][2] = { { &v0, &v1 }, { &v1, &v2 }, { &v2, &v0 } };
+	for (unsigned int i = 0; i < 3; ++i)
+	{
+		const glm::vec3& a = *edges[i][0];
+		const glm::vec3& b = *edges[i][1];
+		const glm::vec3& origin = (a.x < b.x || (a.x == b.x && a.y < b.y)) ? a : b;
+		A[i] = a.y - b.y;
+		B[i] = b.x - a.x;
+		C[i] = -(A[i] * origin.x + B[i] * origin.y);
+	}
+
+	// NDC depth is affine in screen space.
+	float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+	float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+	float dzc = v0.z - dzdx * v0.x - dzdy * v0.y;
+
+	int minX = std::max(0, int(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+	int maxX = std::min(int(WIDTH) - 1, int(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+	int minY = std::max(rowStart, int(std::floor(triangle.minY)));
+	int maxY = std::min(rowEnd - 1, int(std::ceil(triangle.maxY)));
+	if (minX > maxX)
+		return;
+	// Start on a four pixel boundary. WIDTH is a multiple of 4, so the last group stays inside the row.
+	minX &= ~3;
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		float py = float(y) + 0.5f;
+		float rowE0 = B[0] * py + C[0], rowE1 = B[1] * py + C[1], rowE2 = B[2] * py + C[2];
+		float rowZ = dzdy * py + dzc;
+		float* row = &depth[y * WIDTH];
+
+#ifdef OCCLUSION_CULLER_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), px), _mm_set1_ps(rowE0));
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), px), _mm_set1_ps(rowE1));
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), px), _mm_set1_ps(rowE2));
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(rowZ));
+			__m128 current = _mm_loadu_ps(row + x);
+			__m128 closer = _mm_min_ps(current, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, current)));
+		}
+#else
+		for (int x = minX; x <= maxX; ++x)
+		{
+			float px = float(x) + 0.5f;
+			if (A[0] * px + rowE0 >= 0.0f && A[1] * px + rowE1 >= 0.0f && A[2] * px + rowE2 >= 0.0f)
+				row[x] = std::min(row[x], dzdx * px + rowZ);
+		}
+#endif
+	}
+}
+
+OcclusionCuller::Result OcclusionCuller::TestOccludee(const Occludee& occludee) const
+{
+	glm::mat4 mvp = viewProjection * occludee.model;
+
+	float minX = float(WIDTH), minY = float(HEIGHT), maxX = 0.0f, maxY = 0.0f, minZ = 1.0f;
+	unsigned int outside[6] = {};
+	bool crossesNearPlane = false;
+	for (unsigned int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner((i & 1) ? occludee.boundsMax.x : occludee.boundsMin.x,
+			(i & 2) ? occludee.boundsMax.y : occludee.boundsMin.y,
+			(i & 4) ? occludee.boundsMax.z : occludee.boundsMin.z);
+		glm::vec4 c = mvp * glm::vec4(corner, 1.0f);
+
+		outside[0] += c.x < -c.w;
+		outside[1] += c.x > c.w;
+		outside[2] += c.y < -c.w;
+		outside[3] += c.y > c.w;
+		outside[4] += c.z < -c.w;
+		outside[5] += c.z > c.w;
+
+		if (c.w < MIN_W || c.z < -c.w)
+		{
+			crossesNearPlane = true;
+			continue;
+		}
+		float inverseW = 1.0f / c.w;
+		float x = (c.x * inverseW * 0.5f + 0.5f) * WIDTH;
+		float y = (c.y * inverseW * 0.5f + 0.5f) * HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, c.z * inverseW);
+	}
+
+	for (unsigned int plane = 0; plane < 6; ++plane)
+	{
+		if (outside[plane] == 8)
+			return Result::OUTSIDE_FRUSTUM;
+	}
+	// Boxes reaching behind the camera cannot be bounded on screen.
+	if (crossesNearPlane)
+		return Result::VISIBLE;
+
+	int x0 = std::max(0, int(std::floor(minX)));
+	int x1 = std::min(int(WIDTH) - 1, int(std::floor(maxX)));
+	int y0 = std::max(0, int(std::floor(minY)));
+	int y1 = std::min(int(HEIGHT) - 1, int(std::floor(maxY)));
+	if (x0 > x1 || y0 > y1)
+		return Result::VISIBLE;
+
+	for (int tileY = y0 / int(TILE_HEIGHT); tileY <= y1 / int(TILE_HEIGHT); ++tileY)
+	{
+		for (int tileX = x0 / int(TILE_WIDTH); tileX <= x1 / int(TILE_WIDTH); ++tileX)
+		{
+			// Everything in the tile is closer than the box.
+			if (tileMaxDepth[tileY * TILES_X + tileX] < minZ)
+				continue;
+
+			int startX = std::max(x0, tileX * int(TILE_WIDTH)), endX = std::min(x1, (tileX + 1) * int(TILE_WIDTH) - 1);
+			int startY = std::max(y0, tileY * int(TILE_HEIGHT)), endY = std::min(y1, (tileY + 1) * int(TILE_HEIGHT) - 1);
+			for (int y = startY; y <= endY; ++y)
+			{
+				for (int x = startX; x <= endX; ++x)
+				{
+					if (depth[y * WIDTH + x] >= minZ)
+						return Result::VISIBLE;
+				}
+			}
+		}
+	}
+	return Result::OCCLUDED;
+}
+
+OcclusionCuller::Result OcclusionCuller::GetResult(unsigned int occludee) const
+{
+	return results[occludee];
+}
+
+unsigned int OcclusionCuller::GetOccluderTriangleCount() const
+{
+	return (unsigned int)triangles.size();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+class ThreadPool;
+
+// Software occlusion culling. Occluder proxies are rasterized on the CPU into a small depth buffer, and every
+// occludee's screen-space bounding box is tested against it. The buffer is split into tiles that also store their
+// farthest depth, so most tests resolve at tile granularity. Rows of tiles are rasterized and tested in parallel.
+// Depth is NDC z, smaller is closer.
+class OcclusionCuller
+{
+public:
+	static const unsigned int WIDTH			= 256;
+	static const unsigned int HEIGHT		= 128;
+	static const unsigned int TILE_WIDTH	= 16;
+	static const unsigned int TILE_HEIGHT	= 8;
+
+	enum class Result : uint8_t { VISIBLE, OCCLUDED, OUTSIDE_FRUSTUM };
+
+	void         BeginFrame(const glm::mat4& ViewProjection);
+	// Triangles behind the near plane are dropped, which only makes the occluder smaller.
+	void         AddOccluder(const glm::mat4& model, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+	// Returns the index of the occludee's result.
+	unsigned int AddOccludee(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// Rasterizes all occluders and tests all occludees.
+	void         Cull(ThreadPool& threadPool);
+
+	Result       GetResult(unsigned int occludee) const;
+	unsigned int GetOccluderTriangleCount() const;
+
+private:
+	static const unsigned int TILES_X = WIDTH / TILE_WIDTH;
+	static const unsigned int TILES_Y = HEIGHT / TILE_HEIGHT;
+
+	struct ScreenTriangle
+	{
+		glm::vec3 v[3];
+		float     minY, maxY;
+	};
+
+	struct Occludee
+	{
+		glm::mat4 model;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	glm::mat4                   viewProjection;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<Occludee>       occludees;
+	std::vector<Result>         results;
+	// Row-major, WIDTH is a multiple of 4 so rows can be processed four pixels at a time.
+	std::vector<float>          depth			= std::vector<float>(WIDTH * HEIGHT);
+	std::vector<float>          tileMaxDepth	= std::vector<float>(TILES_X * TILES_Y);
+
+	void   RasterizeTileRow(unsigned int tileRow);
+	void   RasterizeTriangle(const ScreenTriangle& triangle, int rowStart, int rowEnd);
+	Result TestOccludee(const Occludee& occludee) const;
+};
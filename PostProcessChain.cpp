@@ -0,0 +1,83 @@
+#include "PostProcessChain.h"
+#include "GLState.h"
+#include "Model.h"
+
+#include <string>
+
+void PostProcessChain::AddPass(const Shader& shader, float resolutionScale, glm::vec2 direction)
+{
+	PostProcessPass pass;
+	pass.shader = shader;
+	pass.resolutionScale = resolutionScale;
+	pass.direction = direction;
+	passes.push_back(pass);
+}
+
+void PostProcessChain::AddSeparablePasses(const Shader& shader, float resolutionScale)
+{
+	// Filters step in texels of their input. A horizontal pass that also reduced the resolution would filter x at the
+	// source's scale and y at the target's, and decimate x with too narrow a kernel. The input is resampled first, by
+	// the filter itself: without a direction all of its taps land on the same bilinear fetch.
+	if (resolutionScale != 1.0f)
+		AddPass(shader, resolutionScale);
+	AddPass(shader, resolutionScale, glm::vec2(1.0f, 0.0f));
+	AddPass(shader, resolutionScale, glm::vec2(0.0f, 1.0f));
+}
+
+void PostProcessChain::Clear()
+{
+	passes.clear();
+}
+
+unsigned int PostProcessChain::GetPassCount() const
+{
+	return (unsigned int)passes.size();
+}
+
+void PostProcessChain::AddToGraph(RenderGraph& graph, RenderResource source, RenderResource output, Model& quad,
+	const Shader& copyShader) const
+{
+	unsigned int sourceWidth = graph.GetWidth(source), sourceHeight = graph.GetHeight(source);
+	bool finalCopy = passes.empty() || passes.back().resolutionScale != 1.0f
+		|| sourceWidth != graph.GetWidth(output) || sourceHeight != graph.GetHeight(output);
+	RenderResource input = source;
+
+	for (size_t i = 0; i < passes.size(); ++i)
+	{
+		const PostProcessPass& pass = passes[i];
+		RenderResource target = output;
+		if (i + 1 < passes.size() || finalCopy)
+		{
+			target = graph.CreateTarget("PostProcess" + std::to_string(i), (unsigned int)(sourceWidth * pass.resolutionScale),
+				(unsigned int)(sourceHeight * pass.resolutionScale), false);
+		}
+
+		Shader shader = pass.shader;
+		glm::vec2 direction = pass.direction;
+		graph.AddPass("PostProcess" + std::to_string(i), { input }, target, [shader, direction, input, &quad](const RenderGraph& graph)
+		{
+			DrawPass(shader, direction, graph, input, quad);
+		});
+		input = target;
+	}
+
+	if (finalCopy)
+	{
+		graph.AddPass("PostProcessCopy", { input }, output, [copyShader, input, &quad](const RenderGraph& graph)
+		{
+			DrawPass(copyShader, glm::vec2(0.0f), graph, input, quad);
+		});
+	}
+}
+
+void PostProcessChain::DrawPass(const Shader& shader, glm::vec2 direction, const RenderGraph& graph, RenderResource source,
+	Model& quad)
+{
+	GLState::Instance().Disable(GL_DEPTH_TEST);
+	shader.use();
+	shader.setInt("screenTexture", 0);
+	shader.setFVec2("texelSize", 1.0f / float(graph.GetWidth(source)), 1.0f / float(graph.GetHeight(source)));
+	shader.setFVec2("direction", direction.x, direction.y);
+	GLState::Instance().BindTexture(0, GL_TEXTURE_2D, graph.GetTexture(source));
+	quad.DrawGeometry(0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Shader.h"
+#include "RenderGraph.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class Model;
+
+struct PostProcessPass
+{
+	Shader    shader;
+	// Size of the pass' target relative to the source. A full resolution pass after a reduced one upsamples it
+	// through bilinear filtering.
+	float     resolutionScale	= 1.0f;
+	// Sampling direction of separable filters.
+	glm::vec2 direction			= { 0.0f, 0.0f };
+};
+
+// A list of full screen passes, each reading the output of the previous one. Every intermediate result is a transient
+// render graph target that dies once the next pass has read it, so a chain of any length ping-pongs between two
+// framebuffers per resolution. Pass shaders get screenTexture, texelSize (of their input) and direction.
+class PostProcessChain
+{
+public:
+	void         AddPass(const Shader& shader, float resolutionScale = 1.0f, glm::vec2 direction = glm::vec2(0.0f));
+	// Adds the horizontal and the vertical pass of a separable filter, whose weights must sum to one. Below full
+	// resolution both run at the reduced size, after a pass that resamples the input to it.
+	void         AddSeparablePasses(const Shader& shader, float resolutionScale = 1.0f);
+	void         Clear();
+	unsigned int GetPassCount() const;
+
+	// Adds the chain to the graph, reading source and writing output. Resolution scales are relative to the source.
+	// A chain that is empty, ends below full resolution or whose source differs in size from the output is finished
+	// with copyShader, which can resample it. The quad and the shaders must
+	// outlive the graph's execution.
+	void         AddToGraph(RenderGraph& graph, RenderResource source, RenderResource output, Model& quad,
+		const Shader& copyShader) const;
+
+private:
+	std::vector<PostProcessPass> passes;
+
+	static void DrawPass(const Shader& shader, glm::vec2 direction, const RenderGraph& graph, RenderResource source,
+		Model& quad);
+};
@@ -0,0 +1,213 @@
+#include "RenderGraph.h"
+#include "Framebuffer.h"
+#include "GLState.h"
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+void RenderGraph::Reset()
+{
+	resources.clear();
+	passes.clear();
+	++frame;
+}
+
+RenderResource RenderGraph::ImportBackbuffer(const std::string& name, unsigned int width, unsigned int height,
+	Framebuffer* framebuffer)
+{
+	Resource resource;
+	resource.name = name;
+	resource.width = width;
+	resource.height = height;
+	resource.depthStencil = true;
+	resource.imported = true;
+	resource.external = framebuffer;
+	resources.push_back(resource);
+	return RenderResource(resources.size() - 1);
+}
+
+RenderResource RenderGraph::CreateTarget(const std::string& name, unsigned int width, unsigned int height, bool depthStencil)
+{
+	Resource resource;
+	resource.name = name;
+	resource.width = std::max(1u, width);
+	resource.height = std::max(1u, height);
+	resource.depthStencil = depthStencil;
+	resource.imported = false;
+	resources.push_back(resource);
+	return RenderResource(resources.size() - 1);
+}
+
+void RenderGraph::AddPass(const std::string& name, std::vector<RenderResource> reads, RenderResource write, PassFunction execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.reads = std::move(reads);
+	pass.write = write;
+	pass.execute = std::move(execute);
+	pass.alive = false;
+	passes.push_back(std::move(pass));
+}
+
+void RenderGraph::Execute(GpuProfiler* profiler)
+{
+	Cull();
+
+	for (int p = 0; p < int(passes.size()); ++p)
+	{
+		const Pass& pass = passes[p];
+		if (!pass.alive)
+			continue;
+		for (RenderResource r : pass.reads)
+		{
+			if (resources[r].firstPass < 0)
+				std::cout << "WARNING::RENDER_GRAPH::Pass " << pass.name << " reads " << resources[r].name << " before it is written." << std::endl;
+		}
+		if (pass.write != NO_RESOURCE && resources[pass.write].firstPass < 0)
+			resources[pass.write].firstPass = p;
+		for (RenderResource r : pass.reads)
+			resources[r].lastPass = p;
+		if (pass.write != NO_RESOURCE)
+			resources[pass.write].lastPass = std::max(resources[pass.write].lastPass, p);
+	}
+
+	for (int p = 0; p < int(passes.size()); ++p)
+	{
+		const Pass& pass = passes[p];
+		if (!pass.alive)
+			continue;
+
+		// Targets are taken from the pool right before their first pass.
+		if (pass.write != NO_RESOURCE)
+		{
+			Resource& target = resources[pass.write];
+			if (!target.imported && target.framebuffer < 0)
+				target.framebuffer = AcquireFramebuffer(target);
+			BindTarget(target);
+		}
+
+		if (profiler)
+			profiler->BeginPass(pass.name);
+		pass.execute(*this);
+		if (profiler)
+			profiler->EndPass();
+
+		// And returned after their last one, so later targets can alias them.
+		for (Resource& resource : resources)
+		{
+			if (resource.lastPass == p && resource.framebuffer >= 0)
+				pool[resource.framebuffer].inUse = false;
+		}
+	}
+
+	for (size_t i = 0; i < pool.size();)
+	{
+		if (frame - pool[i].lastUsedFrame > FRAMES_TO_KEEP_UNUSED)
+		{
+			pool.erase(pool.begin() + i);
+			continue;
+		}
+		++i;
+	}
+}
+
+void RenderGraph::Cull()
+{
+	// Passes are declared in execution order, so one backwards sweep finds every pass that contributes to an
+	// imported resource.
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t r = 0; r < resources.size(); ++r)
+		needed[r] = resources[r].imported;
+
+	culledPasses = 0;
+	for (size_t p = passes.size(); p-- > 0;)
+	{
+		Pass& pass = passes[p];
+		pass.alive = pass.write != NO_RESOURCE && needed[pass.write];
+		if (!pass.alive)
+		{
+			++culledPasses;
+			continue;
+		}
+		for (RenderResource r : pass.reads)
+			needed[r] = true;
+	}
+}
+
+int RenderGraph::AcquireFramebuffer(const Resource& resource)
+{
+	for (size_t i = 0; i < pool.size(); ++i)
+	{
+		PooledFramebuffer& entry = pool[i];
+		if (!entry.inUse && entry.depthStencil == resource.depthStencil
+			&& entry.framebuffer->GetWidth() == resource.width && entry.framebuffer->GetHeight() == resource.height)
+		{
+			entry.inUse = true;
+			entry.lastUsedFrame = frame;
+			return int(i);
+		}
+	}
+
+	PooledFramebuffer entry;
+	entry.framebuffer = std::make_unique<Framebuffer>(resource.width, resource.height, resource.depthStencil);
+	entry.framebuffer->Generate();
+	entry.depthStencil = resource.depthStencil;
+	entry.inUse = true;
+	entry.lastUsedFrame = frame;
+	pool.push_back(std::move(entry));
+	return int(pool.size() - 1);
+}
+
+void RenderGraph::BindTarget(const Resource& resource) const
+{
+	if (resource.external)
+		resource.external->Bind();
+	else if (resource.imported)
+		GLState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+	else
+		pool[resource.framebuffer].framebuffer->Bind();
+	GLState::Instance().Viewport(0, 0, resource.width, resource.height);
+}
+
+unsigned int RenderGraph::GetTexture(RenderResource resource) const
+{
+	const Resource& r = resources[resource];
+	if (r.external)
+		return r.external->GetColorBuffer()->ID;
+	return r.framebuffer >= 0 ? pool[r.framebuffer].framebuffer->GetColorBuffer()->ID : 0;
+}
+
+unsigned int RenderGraph::GetWidth(RenderResource resource) const
+{
+	return resources[resource].width;
+}
+
+unsigned int RenderGraph::GetHeight(RenderResource resource) const
+{
+	return resources[resource].height;
+}
+
+unsigned int RenderGraph::GetCulledPassCount() const
+{
+	return culledPasses;
+}
+
+unsigned int RenderGraph::GetPooledFramebufferCount() const
+{
+	return (unsigned int)pool.size();
+}
+
+size_t RenderGraph::GetPooledBytes() const
+{
+	size_t bytes = 0;
+	for (const PooledFramebuffer& entry : pool)
+	{
+		// RGB8 color, plus a packed 24/8 depth stencil buffer.
+		size_t pixels = size_t(entry.framebuffer->GetWidth()) * entry.framebuffer->GetHeight();
+		bytes += pixels * (entry.depthStencil ? 7 : 3);
+	}
+	return bytes;
+}
+
+RenderGraph::~RenderGraph() = default;
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Framebuffer;
+class GpuProfiler;
+
+typedef unsigned int RenderResource;
+
+// Frame graph of render passes. Every frame passes are declared with the resources they read and the target they
+// write, then Execute() culls passes whose output is never used, gives every transient target a framebuffer from a
+// pool and runs the passes in order. Targets whose lifetimes do not overlap share a framebuffer, so memory grows with
+// the number of targets alive at once rather than with the number of passes.
+class RenderGraph
+{
+public:
+	static const RenderResource NO_RESOURCE				= 0xFFFFFFFF;
+	// Pooled framebuffers unused for this many frames are deleted, for example after a resize.
+	static const unsigned int   FRAMES_TO_KEEP_UNUSED	= 3;
+
+	typedef std::function<void(const RenderGraph&)> PassFunction;
+
+	// Starts declaring a new frame.
+	void           Reset();
+	// The default framebuffer, or a framebuffer standing in for it. Passes writing it are never culled.
+	RenderResource ImportBackbuffer(const std::string& name, unsigned int width, unsigned int height,
+		Framebuffer* framebuffer = nullptr);
+	// A framebuffer that only lives for this frame. Its contents are undefined until the first pass writing it.
+	RenderResource CreateTarget(const std::string& name, unsigned int width, unsigned int height, bool depthStencil);
+	// The target is bound with a viewport covering it before the pass runs.
+	void           AddPass(const std::string& name, std::vector<RenderResource> reads, RenderResource write, PassFunction execute);
+	// Culls, allocates and runs the passes. Each pass is timed if a profiler is given.
+	void           Execute(GpuProfiler* profiler = nullptr);
+
+	// Valid inside a pass function for the resources the pass reads.
+	unsigned int   GetTexture(RenderResource resource) const;
+	unsigned int   GetWidth(RenderResource resource) const;
+	unsigned int   GetHeight(RenderResource resource) const;
+
+	unsigned int   GetCulledPassCount() const;
+	unsigned int   GetPooledFramebufferCount() const;
+	// Approximate memory of all pooled framebuffers.
+	size_t         GetPooledBytes() const;
+
+	~RenderGraph();
+
+private:
+	struct Resource
+	{
+		std::string  name;
+		unsigned int width;
+		unsigned int height;
+		bool         depthStencil;
+		bool         imported;
+		Framebuffer* external		= nullptr;
+		// Pool entry backing the resource during Execute().
+		int          framebuffer	= -1;
+		// First and last live pass using the resource.
+		int          firstPass		= -1;
+		int          lastPass		= -1;
+	};
+
+	struct Pass
+	{
+		std::string                 name;
+		std::vector<RenderResource> reads;
+		RenderResource              write;
+		PassFunction                execute;
+		bool                        alive;
+	};
+
+	struct PooledFramebuffer
+	{
+		std::unique_ptr<Framebuffer> framebuffer;
+		bool                         depthStencil;
+		bool                         inUse			= false;
+		unsigned int                 lastUsedFrame	= 0;
+	};
+
+	std::vector<Resource>          resources;
+	std::vector<Pass>              passes;
+	std::vector<PooledFramebuffer> pool;
+	unsigned int                   frame			= 0;
+	unsigned int                   culledPasses		= 0;
+
+	void Cull();
+	int  AcquireFramebuffer(const Resource& resource);
+	void BindTarget(const Resource& resource) const;
+};
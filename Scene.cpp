@@ -35,6 +35,7 @@ void Scene::OnStartScene()
 	playerInput.BindAction(ActionType::SELECT_4);
 	playerInput.BindAction(ActionType::SELECT_5);
 	playerInput.BindAction(ActionType::SELECT_6);
+	playerInput.BindAction(ActionType::SELECT_7);
 
 	Entity light = Engine::Instance().AddEntity("lightSource");
 	light.addComponent<cPointLight>();
@@ -55,22 +56,22 @@ void Scene::OnStartScene()
 	for (int i = 0; i < 10; ++i)
 	{
 		Entity house = Engine::Instance().AddEntity("house" + std::to_string(i));
-		house.addComponent<cModel>(Engine::Instance().models["house"]);
+		house.addComponent<cModel>(Engine::Instance().GetModel("house"));
 		house.addComponent<cTransform>(glm::vec3(0.0f + i * 35.0f, 0.0f, 0.0f));
 	}
 
 	Entity ashtray = Engine::Instance().AddEntity("ashtray");
-	ashtray.addComponent<cModel>(Engine::Instance().models["ashtray"]);
+	ashtray.addComponent<cModel>(Engine::Instance().GetModel("ashtray"));
 	ashtray.addComponent<cTransform>(glm::vec3(1.0f, 1.4f, 2.0f));
 
 	Entity glass = Engine::Instance().AddEntity("glass");
-	glass.addComponent<cModel>(Engine::Instance().models["transparent_window"]);
+	glass.addComponent<cModel>(Engine::Instance().GetModel("transparent_window"));
 	glass.addComponent<cTransform>(glm::vec3(10.0f, 2.0f, 10.0f));
 
 	Engine::Instance().OutlineEntity(ashtray, glm::vec3(0.0f, 0.5f, 0.8f));
 
 	Entity temple = Engine::Instance().AddEntity("temple");
-	temple.addComponent<cModel>(Engine::Instance().models["commodore"]);
+	temple.addComponent<cModel>(Engine::Instance().GetModel("commodore"));
 	temple.addComponent<cTransform>(glm::vec3(0.0f, 0.0f, 30.0f));
 	Engine::Instance().AddLocalRotation(temple, glm::vec3(0.0f, 1.0f, 0.0f), 180.0f);
 
@@ -102,6 +103,7 @@ void Scene::BindActions()
 	Engine::Instance().BindInputKey(GLFW_KEY_KP_4, ActionType::SELECT_4);
 	Engine::Instance().BindInputKey(GLFW_KEY_KP_5, ActionType::SELECT_5);
 	Engine::Instance().BindInputKey(GLFW_KEY_KP_6, ActionType::SELECT_6);
+	Engine::Instance().BindInputKey(GLFW_KEY_KP_7, ActionType::SELECT_7);
 
 	return;
 }
@@ -172,51 +174,60 @@ void Scene::DefineActions(Entity& e, Action& action)
 		case ActionType::SELECT_0:
 			if (action.eventType == ActionEventType::BEGIN)
 			{
-				Engine::Instance().postProcessingQuad->removeComponent<cShader>();
-				Engine::Instance().postProcessingQuad->addComponent<cShader>(Engine::Instance().postProcessingShaders[ShaderType::POST_PROCESSING_DEFAULT]);
+				Engine::Instance().postProcessChain.Clear();
 			}
 			break;
 		case ActionType::SELECT_1:
 			if (action.eventType == ActionEventType::BEGIN)
 			{
-				Engine::Instance().postProcessingQuad->removeComponent<cShader>();
-				Engine::Instance().postProcessingQuad->addComponent<cShader>(Engine::Instance().postProcessingShaders[ShaderType::COLOR_INVERSION]);
+				Engine::Instance().postProcessChain.Clear();
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::COLOR_INVERSION));
 			}
 			break;
 		case ActionType::SELECT_2:
 			if (action.eventType == ActionEventType::BEGIN)
 			{
-				Engine::Instance().postProcessingQuad->removeComponent<cShader>();
-				Engine::Instance().postProcessingQuad->addComponent<cShader>(Engine::Instance().postProcessingShaders[ShaderType::GRAYSCALE]);
+				Engine::Instance().postProcessChain.Clear();
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::GRAYSCALE));
 			}
 			break;
 		case ActionType::SELECT_3:
 			if (action.eventType == ActionEventType::BEGIN)
 			{
-				Engine::Instance().postProcessingQuad->removeComponent<cShader>();
-				Engine::Instance().postProcessingQuad->addComponent<cShader>(Engine::Instance().postProcessingShaders[ShaderType::SHARPEN]);
+				Engine::Instance().postProcessChain.Clear();
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::SHARPEN));
 			}
 			break;
 		case ActionType::SELECT_4:
 			if (action.eventType == ActionEventType::BEGIN)
 			{
-				Engine::Instance().postProcessingQuad->removeComponent<cShader>();
-				Engine::Instance().postProcessingQuad->addComponent<cShader>(Engine::Instance().postProcessingShaders[ShaderType::BLUR]);
+				Engine::Instance().postProcessChain.Clear();
+				// Blurring at half resolution costs a quarter and is hardly visible.
+				Engine::Instance().postProcessChain.AddSeparablePasses(Engine::Instance().GetShader(ShaderType::BLUR), 0.5f);
 			}
 			break;
 		
 		case ActionType::SELECT_5:
 			if (action.eventType == ActionEventType::BEGIN)
 			{
-				Engine::Instance().postProcessingQuad->removeComponent<cShader>();
-				Engine::Instance().postProcessingQuad->addComponent<cShader>(Engine::Instance().postProcessingShaders[ShaderType::EDGE_DETECTION]);
+				Engine::Instance().postProcessChain.Clear();
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::EDGE_DETECTION));
 			}
 			break;
 		case ActionType::SELECT_6:
 			if (action.eventType == ActionEventType::BEGIN)
 			{
-				Engine::Instance().postProcessingQuad->removeComponent<cShader>();
-				Engine::Instance().postProcessingQuad->addComponent<cShader>(Engine::Instance().postProcessingShaders[ShaderType::CUSTOM_EFFECT]);
+				Engine::Instance().postProcessChain.Clear();
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::CUSTOM_EFFECT));
+			}
+			break;
+		case ActionType::SELECT_7:
+			if (action.eventType == ActionEventType::BEGIN)
+			{
+				Engine::Instance().postProcessChain.Clear();
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::GRAYSCALE));
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::SHARPEN));
+				Engine::Instance().postProcessChain.AddPass(Engine::Instance().GetShader(ShaderType::EDGE_DETECTION));
 			}
 			break;
 		}
@@ -11,12 +11,13 @@ class Scene
 public:
 	Scene();
 	explicit Scene(const std::string& Name);
+	virtual ~Scene() = default;
 
 public:
-	void OnStartScene();
-	void BindActions();
-	void OnUpdate();
-	void DefineActions(Entity& e, Action& action);
+	virtual void OnStartScene();
+	virtual void BindActions();
+	virtual void OnUpdate();
+	virtual void DefineActions(Entity& e, Action& action);
 
 public:
 	std::string name;
@@ -2,6 +2,7 @@
 #include "Shader.h"
 
 #include <glad/glad.h>
+#include "GLState.h"
 #include <glm/gtc/type_ptr.hpp>
 
 #include <fstream>
@@ -11,12 +12,12 @@
 Shader::Shader()
 {}
 
-Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath)
+Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
 {
-	load(vertexPath, fragmentPath);
+	load(vertexPath, fragmentPath, defines);
 }
 
-void Shader::load(const std::string& vertexPath, const std::string& fragmentPath)
+void Shader::load(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
 {
 	std::ifstream vertexIFS;
 	vertexIFS.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -46,7 +47,21 @@ void Shader::load(const std::string& vertexPath, const std::string& fragmentPath
 		std::cout << "ERROR::OPENING_FRAGMENT_SHADER_SOURCE_CODE" << std::endl;
 	}
 
-	generateShaderProgram(vertexOSS.str().c_str(), fragmentOSS.str().c_str());
+	std::string vertexSource = insertDefines(vertexOSS.str(), defines);
+	std::string fragmentSource = insertDefines(fragmentOSS.str(), defines);
+	generateShaderProgram(vertexSource.c_str(), fragmentSource.c_str());
+}
+
+std::string Shader::insertDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return source;
+
+	// #version has to stay the first statement.
+	size_t versionEnd = source.find('\n');
+	if (versionEnd == std::string::npos)
+		return source + "\n" + defines;
+	return source.substr(0, versionEnd + 1) + defines + source.substr(versionEnd + 1);
 }
 
 void Shader::generateShaderProgram(const char* vertexSource, const char* fragmentSource)
@@ -96,7 +111,7 @@ void Shader::generateShaderProgram(const char* vertexSource, const char* fragmen
 
 void Shader::use() const
 {
-	glUseProgram(ID);
+	GLState::Instance().UseProgram(ID);
 }
 
 void Shader::setBool(const std::string& name, bool value) const
@@ -124,6 +139,11 @@ void Shader::setFVector(const std::string& name, float x, float y, float z, floa
 	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
 }
 
+void Shader::setFVec2(const std::string& name, float x, float y) const
+{
+	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+}
+
 void Shader::setFVec3(const std::string& name, float x, float y, float z) const
 {
 	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
@@ -142,4 +162,11 @@ void Shader::setFVec3(const std::string& name, const glm::vec3& vec)
 void Shader::setFMat3(const std::string& name, glm::mat3& mat3)
 {
 	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat3));
+}
+
+void Shader::bindUniformBlock(const std::string& name, unsigned int binding) const
+{
+	unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, index, binding);
 }
\ No newline at end of file
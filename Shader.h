@@ -11,8 +11,9 @@ public:
 	unsigned int ID = -1;
 	
 	Shader();
-	Shader(const std::string& vertexPath, const std::string& fragmentPath);
-	void load(const std::string& vertexPath, const std::string& fragmentPath);
+	Shader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+	// Defines are inserted right after the #version line of both stages, e.g. "#define TEXTURE_ARRAYS\n".
+	void load(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
 	// Use shader.
 	void use() const;
 	// Utility uniform functions.
@@ -21,12 +22,16 @@ public:
 	void setInt(const std::string& name, int value) const;
 	void setFloat(const std::string& name, float value) const;
 	void setFVector(const std::string& name, float x, float y, float z, float w) const;
+	void setFVec2(const std::string& name, float x, float y) const;
 	void setFVec3(const std::string& name, float x, float y, float z) const;
 	void setFVec3(const std::string& name, const glm::vec3& vec);
 	void setFMat4(const std::string& name, glm::mat4& mat4);
 	void setFMat3(const std::string& name, glm::mat3& mat3);
+	// Assigns a uniform block to a binding point. Does nothing if the program has no such block.
+	void bindUniformBlock(const std::string& name, unsigned int binding) const;
 
 private:
+	static std::string insertDefines(const std::string& source, const std::string& defines);
 	void generateShaderProgram(const char* vertexSource, const char* fragmentSource);
 
 };
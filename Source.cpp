@@ -1,22 +1,185 @@
 #include "Engine.h"
 #include "EntityManager.h"
+#include "GLState.h"
+#include "StressScene.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
+bool parse_post_processing(const std::string& list, std::vector<ShaderType>& effects);
 
-int main()
+// --headless                 render offscreen without presenting
+// --context native|egl|osmesa
+// --frames N                 stop after N frames
+// --duration S               stop after S seconds
+// --camera-path FILE         fly the camera along the keyframes in FILE
+//
+// --benchmark                run a generated stress scene along a fixed flythrough and record every frame
+// --instances N              objects per model
+// --point-lights N
+// --spot-lights N
+// --transparent F            fraction of transparent objects
+// --outlined N               outlined objects
+// --post a,b,...             effects out of invert, grayscale, sharpen, blur, edge, custom
+// --seed N
+// --csv FILE                 write per-frame results
+// --json FILE                write the summary and per-frame results, usable as a baseline
+// --baseline FILE            compare against the summary in FILE
+// --threshold F              allowed slowdown against the baseline, 0.1 for 10%
+int main(int argc, char** argv)
 {
-	Engine::Instance().BindFramebufferSizeCallback(framebuffer_size_callback);
-	Engine::Instance().BindCursorPositionCallback(mouse_callback);
+	unsigned long long frames = 0;
+	double duration = 0.0;
+	std::string cameraPath;
+	bool benchmark = false;
+	StressSceneSettings stressSettings;
+	std::string csvPath, jsonPath, baselinePath;
+	float threshold = 0.1f;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (argument == "--headless")
+			Engine::HEADLESS = true;
+		else if (argument == "--context" && hasValue)
+		{
+			std::string api = argv[++i];
+			if (api == "egl")
+				Engine::CONTEXT_CREATION_API = GLFW_EGL_CONTEXT_API;
+			else if (api == "osmesa")
+				Engine::CONTEXT_CREATION_API = GLFW_OSMESA_CONTEXT_API;
+			else if (api == "native")
+				Engine::CONTEXT_CREATION_API = GLFW_NATIVE_CONTEXT_API;
+			else
+			{
+				std::cout << "ERROR::MAIN::Unknown context creation API " << api << ", expected native, egl or osmesa." << std::endl;
+				return int(ExitCode::INVALID_ARGUMENTS);
+			}
+		}
+		else if (argument == "--frames" && hasValue)
+			frames = std::strtoull(argv[++i], nullptr, 10);
+		else if (argument == "--duration" && hasValue)
+			duration = std::strtod(argv[++i], nullptr);
+		else if (argument == "--camera-path" && hasValue)
+			cameraPath = argv[++i];
+		else if (argument == "--benchmark")
+			benchmark = true;
+		else if (argument == "--instances" && hasValue)
+			stressSettings.instancesPerModel = unsigned(std::strtoul(argv[++i], nullptr, 10));
+		else if (argument == "--point-lights" && hasValue)
+			stressSettings.pointLights = unsigned(std::strtoul(argv[++i], nullptr, 10));
+		else if (argument == "--spot-lights" && hasValue)
+			stressSettings.spotLights = unsigned(std::strtoul(argv[++i], nullptr, 10));
+		else if (argument == "--transparent" && hasValue)
+			stressSettings.transparentFraction = std::strtof(argv[++i], nullptr);
+		else if (argument == "--outlined" && hasValue)
+			stressSettings.outlinedObjects = unsigned(std::strtoul(argv[++i], nullptr, 10));
+		else if (argument == "--post" && hasValue)
+		{
+			if (!parse_post_processing(argv[++i], stressSettings.postProcessing))
+				return int(ExitCode::INVALID_ARGUMENTS);
+		}
+		else if (argument == "--seed" && hasValue)
+			stressSettings.seed = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+		else if (argument == "--csv" && hasValue)
+			csvPath = argv[++i];
+		else if (argument == "--json" && hasValue)
+			jsonPath = argv[++i];
+		else if (argument == "--baseline" && hasValue)
+			baselinePath = argv[++i];
+		else if (argument == "--threshold" && hasValue)
+			threshold = std::strtof(argv[++i], nullptr);
+		else
+		{
+			std::cout << "ERROR::MAIN::Unknown or incomplete argument " << argument << std::endl;
+			return int(ExitCode::INVALID_ARGUMENTS);
+		}
+	}
+
+	Engine& engine = Engine::Instance();
+	engine.maxFrames = frames;
+	engine.maxDuration = duration;
+	if (!cameraPath.empty() && !engine.cameraPath.Load(cameraPath))
+		std::quick_exit(int(ExitCode::INVALID_ARGUMENTS));
+
+	BenchmarkSummary baseline;
+	if (benchmark)
+	{
+		if (!baselinePath.empty() && !Benchmark::LoadSummary(baselinePath, baseline))
+			std::quick_exit(int(ExitCode::INVALID_ARGUMENTS));
+
+		engine.BENCHMARK = true;
+		engine.GPU_PROFILING = true;
+		engine.startScene = std::make_shared<StressScene>(stressSettings);
+		// The simulation advances one step per frame, so the flythrough takes a fixed number of frames.
+		if (frames == 0 && duration == 0.0)
+		{
+			double flythrough = cameraPath.empty() ? stressSettings.flythroughDuration : engine.cameraPath.GetDuration();
+			engine.maxFrames = engine.benchmark.warmupFrames + (unsigned long long)(flythrough * engine.simulationRate);
+		}
+	}
+
+	engine.BindFramebufferSizeCallback(framebuffer_size_callback);
+	engine.BindCursorPositionCallback(mouse_callback);
+
+	int exitCode = engine.Run();
+	// Without a context the engine's GL objects cannot be released, so skip its destruction.
+	if (exitCode == int(ExitCode::INITIALIZATION_FAILED))
+		std::quick_exit(exitCode);
+
+	if (benchmark)
+	{
+		BenchmarkSummary summary = engine.benchmark.Summarize();
+		std::cout << "BENCHMARK::" << summary.frames << " frames, CPU avg " << summary.cpuAverage << " ms p95 " << summary.cpuP95
+			<< " ms, GPU avg " << summary.gpuAverage << " ms p95 " << summary.gpuP95 << " ms, " << summary.drawCallsAverage
+			<< " draw calls, " << summary.trianglesAverage << " triangles" << std::endl;
+		if (!csvPath.empty())
+			engine.benchmark.WriteCsv(csvPath);
+		if (!jsonPath.empty())
+			engine.benchmark.WriteJson(jsonPath);
+		if (!baselinePath.empty() && exitCode == int(ExitCode::SUCCESS)
+			&& engine.benchmark.CompareToBaseline(baseline, threshold, std::cout) > 0)
+			exitCode = int(ExitCode::BENCHMARK_REGRESSION);
+	}
 
-	Engine::Instance().Run();
+	return exitCode;
+}
 
-	return 0;
+bool parse_post_processing(const std::string& list, std::vector<ShaderType>& effects)
+{
+	std::stringstream stream(list);
+	std::string name;
+	while (std::getline(stream, name, ','))
+	{
+		if (name == "invert")
+			effects.push_back(ShaderType::COLOR_INVERSION);
+		else if (name == "grayscale")
+			effects.push_back(ShaderType::GRAYSCALE);
+		else if (name == "sharpen")
+			effects.push_back(ShaderType::SHARPEN);
+		else if (name == "blur")
+			effects.push_back(ShaderType::BLUR);
+		else if (name == "edge")
+			effects.push_back(ShaderType::EDGE_DETECTION);
+		else if (name == "custom")
+			effects.push_back(ShaderType::CUSTOM_EFFECT);
+		else
+		{
+			std::cout << "ERROR::MAIN::Unknown post-processing effect " << name << std::endl;
+			return false;
+		}
+	}
+	return true;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	GLState::Instance().Viewport(0, 0, width, height);
 }
 
 void mouse_callback(GLFWwindow* window, double xPos, double yPos)
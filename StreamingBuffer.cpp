@@ -0,0 +1,131 @@
+#include "StreamingBuffer.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+StreamingBuffer::StreamingBuffer(GLenum Target, size_t FrameSize)
+	: target{ Target }, frameSize{ FrameSize }
+{}
+
+void StreamingBuffer::Generate()
+{
+	// Uniform buffer ranges have to start at an implementation defined alignment.
+	if (target == GL_UNIFORM_BUFFER)
+	{
+		GLint uniformAlignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+		alignment = size_t(uniformAlignment);
+	}
+	frameSize = GetAlignedSize(frameSize);
+
+	glGenBuffers(1, &ID);
+	glBindBuffer(target, ID);
+	glBufferData(target, frameSize * FRAMES_IN_FLIGHT, NULL, GL_STREAM_DRAW);
+	glBindBuffer(target, 0);
+}
+
+void StreamingBuffer::Reserve(size_t frameBytes)
+{
+	if (frameBytes <= frameSize || mapped)
+		return;
+
+	// Grow by half again, so that a slowly rising count does not reallocate every frame.
+	frameSize = GetAlignedSize(std::max(frameBytes, frameSize + frameSize / 2));
+	for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+
+	glBindBuffer(target, ID);
+	glBufferData(target, frameSize * FRAMES_IN_FLIGHT, NULL, GL_STREAM_DRAW);
+	glBindBuffer(target, 0);
+	std::cout << "Streaming buffer with ID: " << ID << " grown to " << frameSize << " bytes per frame." << std::endl;
+}
+
+size_t StreamingBuffer::GetAlignedSize(size_t size) const
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+void StreamingBuffer::BeginFrame()
+{
+	// Make sure the GPU has finished reading the region from FRAMES_IN_FLIGHT frames ago.
+	if (fences[frameIndex])
+	{
+		GLenum result = glClientWaitSync(fences[frameIndex], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			++stallCount;
+			do
+			{
+				result = glClientWaitSync(fences[frameIndex], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fences[frameIndex]);
+		fences[frameIndex] = 0;
+	}
+
+	glBindBuffer(target, ID);
+	mapped = (unsigned char*)glMapBufferRange(target, frameIndex * frameSize, frameSize,
+		GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	head = 0;
+
+	if (!mapped)
+		std::cout << "ERROR::STREAMING_BUFFER::Failed to map region " << frameIndex << " of buffer with ID: " << ID << std::endl;
+}
+
+GLintptr StreamingBuffer::Write(const void* data, size_t size)
+{
+	if (!mapped || head + size > frameSize)
+		return -1;
+
+	std::memcpy(mapped + head, data, size);
+	GLintptr offset = GLintptr(frameIndex * frameSize + head);
+	head += GetAlignedSize(size);
+	return offset;
+}
+
+void StreamingBuffer::Flush()
+{
+	if (!mapped)
+		return;
+
+	glBindBuffer(target, ID);
+	glUnmapBuffer(target);
+	mapped = nullptr;
+}
+
+void StreamingBuffer::EndFrame()
+{
+	fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
+}
+
+unsigned int StreamingBuffer::GetID() const
+{
+	return ID;
+}
+
+GLenum StreamingBuffer::GetTarget() const
+{
+	return target;
+}
+
+unsigned int StreamingBuffer::GetStallCount() const
+{
+	return stallCount;
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+	for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	}
+	GLState::Instance().DeleteBuffers(1, &ID);
+}
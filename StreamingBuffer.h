@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Ring buffer for per-frame transient GPU data (per-object matrices, instance data, post-processing parameters).
+// The buffer is split into one region per frame in flight. A region is written through an unsynchronized mapping
+// and only reused after the fence placed at the end of its frame has signaled, so the CPU never waits on the
+// driver's implicit synchronization.
+class StreamingBuffer
+{
+public:
+	static const unsigned int FRAMES_IN_FLIGHT = 3;
+
+	StreamingBuffer(GLenum Target, size_t FrameSize);
+	~StreamingBuffer();
+
+	void         Generate();
+	// Grows the regions to hold at least frameBytes, outside of BeginFrame() and Flush(). The old storage is orphaned,
+	// so frames still in flight keep reading it.
+	void         Reserve(size_t frameBytes);
+	// Bytes a write of size takes up in a region.
+	size_t       GetAlignedSize(size_t size) const;
+	// Waits for the GPU to release this frame's region and maps it for writing.
+	void         BeginFrame();
+	// Copies data into the current region. Returns the offset from the start of the buffer, or -1 if the region is full.
+	GLintptr     Write(const void* data, size_t size);
+	// Unmaps the region so that draws can source from it.
+	void         Flush();
+	// Fences the region and advances to the next one.
+	void         EndFrame();
+
+	unsigned int GetID() const;
+	GLenum       GetTarget() const;
+	// Number of times BeginFrame had to block on a fence.
+	unsigned int GetStallCount() const;
+
+private:
+	unsigned int   ID				= 0;
+	GLenum         target;
+	size_t         frameSize;
+	size_t         alignment		= 256;
+	GLsync         fences[FRAMES_IN_FLIGHT] = { 0 };
+	unsigned int   frameIndex		= 0;
+	unsigned char* mapped			= nullptr;
+	size_t         head				= 0;
+	unsigned int   stallCount		= 0;
+};
@@ -0,0 +1,168 @@
+#include "StressScene.h"
+#include "Engine.h"
+#include "Entity.h"
+#include "EntityManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	// Standard library distributions differ between implementations, so numbers come from a small generator of our own.
+	class Random
+	{
+	public:
+		explicit Random(uint32_t seed) : state{ seed * 0x9E3779B9u + 0x7F4A7C15u } {}
+
+		uint32_t Next()
+		{
+			// xorshift32, which must not start from zero.
+			if (state == 0)
+				state = 0x6D2B79F5u;
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		// Uniform in [min, max).
+		float Range(float min, float max)
+		{
+			return min + (max - min) * float(Next() >> 8) / float(1u << 24);
+		}
+
+	private:
+		uint32_t state;
+	};
+
+	// Whether item i of count is one of selected items spread evenly over them.
+	bool Selected(unsigned int i, unsigned int selected, unsigned int count)
+	{
+		return (unsigned long long)(i + 1) * selected / count != (unsigned long long)i * selected / count;
+	}
+
+	const unsigned int MAX_POINT_LIGHTS	= 32;
+	const unsigned int MAX_SPOT_LIGHTS	= 32;
+}
+
+StressScene::StressScene(const StressSceneSettings& Settings)
+	: Scene("stressScene"), settings{ Settings } {}
+
+void StressScene::OnStartScene()
+{
+	Engine& engine = Engine::Instance();
+	Random random(settings.seed);
+
+	// Models are sorted by transparency, which is only known once they are loaded.
+	for (const std::string& name : engine.GetModelNames())
+		engine.GetModel(name);
+	engine.WaitForModels();
+
+	std::vector<ModelHandle> opaqueModels, transparentModels;
+	for (const std::string& name : engine.GetModelNames())
+	{
+		ModelHandle model = engine.GetModel(name);
+		const Model* loaded = engine.assets.Get(model);
+		if (loaded)
+			(loaded->isTransparent ? transparentModels : opaqueModels).push_back(model);
+	}
+
+	unsigned int objectCount = settings.instancesPerModel * unsigned(opaqueModels.size() + transparentModels.size());
+	unsigned int transparentCount = unsigned(std::lround(std::clamp(settings.transparentFraction, 0.0f, 1.0f) * objectCount));
+	if (transparentModels.empty())
+		transparentCount = 0;
+	if (opaqueModels.empty())
+		transparentCount = objectCount;
+	if (transparentCount != unsigned(std::lround(settings.transparentFraction * objectCount)))
+		std::cout << "WARNING::STRESS_SCENE::Transparent fraction adjusted to the loaded models." << std::endl;
+
+	unsigned int side = std::max(1u, unsigned(std::ceil(std::sqrt(double(objectCount)))));
+	float extent = side * settings.spacing;
+	auto gridPosition = [&](unsigned int i)
+	{
+		return glm::vec3((float(i % side) - 0.5f * float(side - 1)) * settings.spacing, 0.0f,
+			(float(i / side) - 0.5f * float(side - 1)) * settings.spacing);
+	};
+
+	unsigned int opaqueIndex = 0, transparentIndex = 0;
+	for (unsigned int i = 0; i < objectCount; ++i)
+	{
+		bool transparent = Selected(i, transparentCount, objectCount);
+		ModelHandle model = transparent ? transparentModels[transparentIndex++ % transparentModels.size()]
+			: opaqueModels[opaqueIndex++ % opaqueModels.size()];
+
+		Entity object = engine.AddEntity("stress" + std::to_string(i));
+		object.addComponent<cModel>(model);
+		object.addComponent<cTransform>(gridPosition(i));
+		engine.AddLocalRotation(object, glm::vec3(0.0f, 1.0f, 0.0f), random.Range(0.0f, 360.0f));
+
+		if (Selected(i, std::min(settings.outlinedObjects, objectCount), objectCount))
+			engine.OutlineEntity(object, glm::vec3(random.Range(0.2f, 1.0f), random.Range(0.2f, 1.0f), random.Range(0.2f, 1.0f)));
+	}
+	if (transparentCount > 0)
+		engine.SetBlending(true);
+
+	unsigned int pointLights = std::min(settings.pointLights, MAX_POINT_LIGHTS);
+	unsigned int spotLights = std::min(settings.spotLights, MAX_SPOT_LIGHTS);
+	if (pointLights != settings.pointLights || spotLights != settings.spotLights)
+		std::cout << "WARNING::STRESS_SCENE::Light counts capped at " << MAX_POINT_LIGHTS << " point and " << MAX_SPOT_LIGHTS << " spot lights." << std::endl;
+
+	for (unsigned int i = 0; i < pointLights; ++i)
+	{
+		Entity light = engine.AddEntity("stressPointLight" + std::to_string(i));
+		light.addComponent<cPointLight>();
+		light.addComponent<cTransform>(glm::vec3(random.Range(-0.5f, 0.5f) * extent, random.Range(2.0f, 6.0f), random.Range(-0.5f, 0.5f) * extent));
+		light.getComponent<cTransform>().scale = glm::vec3(0.2f);
+		light.getComponent<cPointLight>().diffuse = glm::vec3(random.Range(0.3f, 1.0f), random.Range(0.3f, 1.0f), random.Range(0.3f, 1.0f));
+		light.getComponent<cPointLight>().ambient = glm::vec3(0.02f);
+	}
+	for (unsigned int i = 0; i < spotLights; ++i)
+	{
+		Entity light = engine.AddEntity("stressSpotLight" + std::to_string(i));
+		light.addComponent<cSpotLight>();
+		light.addComponent<cTransform>(glm::vec3(random.Range(-0.5f, 0.5f) * extent, random.Range(6.0f, 10.0f), random.Range(-0.5f, 0.5f) * extent));
+		// Aim down at the grid, in a random direction.
+		engine.AddLocalRotation(light, glm::vec3(1.0f, 0.0f, 0.0f), random.Range(50.0f, 90.0f));
+		engine.AddLocalRotation(light, glm::vec3(0.0f, 1.0f, 0.0f), random.Range(0.0f, 360.0f));
+		light.getComponent<cSpotLight>().diffuse = glm::vec3(random.Range(0.3f, 1.0f), random.Range(0.3f, 1.0f), random.Range(0.3f, 1.0f));
+		light.getComponent<cSpotLight>().ambient = glm::vec3(0.0f);
+	}
+	engine.AddGlobalLight();
+
+	engine.postProcessChain.Clear();
+	for (ShaderType effect : settings.postProcessing)
+	{
+		if (effect == ShaderType::BLUR)
+			engine.postProcessChain.AddSeparablePasses(engine.GetShader(effect), 0.5f);
+		else
+			engine.postProcessChain.AddPass(engine.GetShader(effect));
+	}
+
+	Entity camera = engine.AddEntity("player");
+	camera.addComponent<cTransform>(glm::vec3(0.0f, 10.0f, extent));
+	camera.addComponent<cCamera>();
+	engine.SetMainCamera(&camera.getComponent<cCamera>());
+
+	// Circle the grid looking at its center, alternating between a wide high orbit and a low pass through the objects.
+	if (engine.cameraPath.IsEmpty())
+	{
+		const unsigned int keyframes = 16;
+		for (unsigned int i = 0; i <= keyframes; ++i)
+		{
+			float angle = 360.0f * float(i) / float(keyframes);
+			bool wide = i % 2 == 0;
+			float radius = (wide ? 0.75f : 0.3f) * extent + settings.spacing;
+			float height = wide ? 0.25f * extent + 4.0f : 3.0f;
+
+			CameraKeyframe keyframe;
+			keyframe.time = settings.flythroughDuration * float(i) / float(keyframes);
+			keyframe.position = glm::vec3(radius * std::cos(glm::radians(angle)), height, radius * std::sin(glm::radians(angle)));
+			// Yaw 0 looks down -z, so facing the center from this angle is a quarter turn behind it.
+			keyframe.yaw = angle - 90.0f;
+			keyframe.pitch = -glm::degrees(std::atan2(height, radius));
+			engine.cameraPath.AddKeyframe(keyframe);
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Scene.h"
+#include "Enums.h"
+
+#include <cstdint>
+#include <vector>
+
+struct StressSceneSettings
+{
+	// The scene holds instancesPerModel objects for every loaded model, laid out on a square grid.
+	unsigned int            instancesPerModel	= 10;
+	// Capped at the light array sizes of the fragment shader.
+	unsigned int            pointLights			= 8;
+	unsigned int            spotLights			= 0;
+	// Fraction of the objects that use transparent models, the rest cycle through the opaque ones.
+	float                   transparentFraction	= 0.1f;
+	unsigned int            outlinedObjects		= 4;
+	// Post-processing effects applied in order. BLUR adds its two half resolution passes.
+	std::vector<ShaderType> postProcessing;
+	float                   spacing				= 12.0f;
+	// Length of the generated camera flythrough, used if the engine has no camera path yet.
+	float                   flythroughDuration	= 20.0f;
+	uint32_t                seed				= 1;
+};
+
+// A generated scene for benchmarks. The same settings and seed give the same scene on every platform.
+class StressScene : public Scene
+{
+public:
+	explicit StressScene(const StressSceneSettings& Settings);
+
+	void OnStartScene() override;
+
+public:
+	StressSceneSettings settings;
+};
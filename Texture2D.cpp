@@ -1,9 +1,14 @@
 #include "Texture2D.h"
 #include "stb_image.h"
 #include "Shader.h"
+#include "GLState.h"
+#include "Engine.h"
+#include "TextureCooker.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 
 Texture2D::Texture2D()
@@ -15,20 +20,13 @@ bool Texture2D::load(const std::string& path, TextureInfo& info)
 {
 	this->path = path;
 
-	// Generate and bind texture.
-	glGenTextures(1, &ID);
-	glBindTexture(GL_TEXTURE_2D, ID);
-
-	// Set texture parameters.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, horizontalWrapMode);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, verticalWrapMode);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+	Engine& engine = Engine::Instance();
+	if (engine.COOK_TEXTURES && loadCooked(path, info))
+		return true;
 
-	// Load data.
+	// Only the header is read here. With asynchronous uploads the file is decoded on the thread pool.
 	int width, height, nrChannels;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-	if (!data)
+	if (!stbi_info(path.c_str(), &width, &height, &nrChannels))
 	{
 		std::cerr << "Failed to load texture from path '" << path << "'" << std::endl;
 		return false;
@@ -50,10 +48,57 @@ bool Texture2D::load(const std::string& path, TextureInfo& info)
 		break;
 	default:
 		std::cout << "Texture of unknown format at path : " << path << std::endl;
-		stbi_image_free(data);
 		return false;
 	}
-	
+
+	// Generate and bind texture.
+	glGenTextures(1, &ID);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D, ID);
+
+	// Set texture parameters.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, horizontalWrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, verticalWrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+
+	if (engine.ASYNC_UPLOADS)
+	{
+		// Level 0 only until the upload queue has filled it and generated the mipmaps, so the texture is complete
+		// while it streams in.
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+		unsigned int texture = ID;
+		uploadTickets = std::make_shared<UploadTickets>();
+		std::shared_ptr<UploadTickets> tickets = uploadTickets;
+		engine.threadPool.Enqueue([path, texture, width, height, nrChannels, format, tickets]()
+		{
+			std::vector<unsigned char> pixels;
+			int decodedWidth, decodedHeight, decodedChannels;
+			unsigned char* data = stbi_load(path.c_str(), &decodedWidth, &decodedHeight, &decodedChannels, nrChannels);
+			if (data && decodedWidth == width && decodedHeight == height)
+				pixels.assign(data, data + size_t(width) * height * nrChannels);
+			else
+			{
+				std::cerr << "Failed to load texture from path '" << path << "'" << std::endl;
+				pixels.assign(size_t(width) * height * nrChannels, 255);
+			}
+			stbi_image_free(data);
+			uint64_t ticket = Engine::Instance().uploadQueue.UploadTexture(texture, 0, width, height, format, std::move(pixels), TextureCompletion::GENERATE_MIPMAPS);
+			tickets->ready = ticket;
+			tickets->last = ticket;
+		});
+		return true;
+	}
+
+	// Load data.
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+	if (!data)
+	{
+		std::cerr << "Failed to load texture from path '" << path << "'" << std::endl;
+		return false;
+	}
+
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 	// Generate mipmap.
@@ -67,10 +112,97 @@ bool Texture2D::load(const std::string& path, TextureInfo& info)
 	return true;
 }
 
+bool Texture2D::loadCooked(const std::string& path, TextureInfo& info)
+{
+	Engine& engine = Engine::Instance();
+	std::string cookedPath = TextureCooker::GetCookedPath(path);
+	if (!TextureCooker::IsUpToDate(path, cookedPath, engine.textureCookSettings)
+		&& !TextureCooker::Cook(path, cookedPath, engine.textureCookSettings, engine.threadPool))
+		return false;
+
+	// With asynchronous uploads only the header is read here, the levels are read on the thread pool.
+	CookedTexture cooked;
+	if (!TextureCooker::Load(cookedPath, cooked, engine.ASYNC_UPLOADS) || cooked.levelCount == 0)
+		return false;
+	info.alphaChannel = cooked.alphaChannel;
+
+	glGenTextures(1, &ID);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D, ID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, horizontalWrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, verticalWrapMode);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (unsigned int level = 0; level < cooked.levelCount; ++level)
+	{
+		unsigned int width = std::max(1u, cooked.width >> level), height = std::max(1u, cooked.height >> level);
+		const void* data = engine.ASYNC_UPLOADS ? NULL : cooked.levels[level].data();
+		if (cooked.compressed)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, cooked.internalFormat, width, height, 0,
+				GLsizei(TextureCooker::GetLevelSize(cooked.internalFormat, width, height)), data);
+		}
+		else
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	}
+
+	if (!engine.ASYNC_UPLOADS)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(cooked.levelCount - 1));
+		return true;
+	}
+
+	// Levels arrive smallest first, so the texture is soon sampled at a coarse level and sharpens as the base level is
+	// lowered.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(cooked.levelCount - 1));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(cooked.levelCount - 1));
+	unsigned int texture = ID;
+	uploadTickets = std::make_shared<UploadTickets>();
+	std::shared_ptr<UploadTickets> tickets = uploadTickets;
+	engine.threadPool.Enqueue([cookedPath, texture, tickets]()
+	{
+		CookedTexture cooked;
+		if (!TextureCooker::Load(cookedPath, cooked))
+		{
+			tickets->last = 0;
+			return;
+		}
+		GLenum format = cooked.compressed ? cooked.internalFormat : GL_RGBA;
+		uint64_t lastTicket = 0;
+		for (unsigned int level = cooked.levelCount; level-- > 0;)
+		{
+			unsigned int width = std::max(1u, cooked.width >> level), height = std::max(1u, cooked.height >> level);
+			lastTicket = Engine::Instance().uploadQueue.UploadTexture(texture, level, width, height, format, std::move(cooked.levels[level]),
+				TextureCompletion::ENABLE_LEVELS);
+			if (level == cooked.levelCount - 1)
+				tickets->ready = lastTicket;
+		}
+		// Tickets are issued in order, level 0 completes after the others.
+		tickets->last = lastTicket;
+	});
+	return true;
+}
+
 void Texture2D::use() const
 {
-	glActiveTexture(GL_TEXTURE0 + textureID);
-	glBindTexture(GL_TEXTURE_2D, ID);
+	GLState::Instance().BindTexture(textureID, GL_TEXTURE_2D, ID);
+}
+
+bool Texture2D::isUploadPending() const
+{
+	if (!uploadTickets)
+		return false;
+	uint64_t ticket = uploadTickets->last;
+	return ticket == PENDING_UPLOAD || (ticket != 0 && !Engine::Instance().uploadQueue.IsComplete(ticket));
+}
+
+bool Texture2D::isReady() const
+{
+	if (!uploadTickets)
+		return true;
+	uint64_t ticket = uploadTickets->ready;
+	return ticket != PENDING_UPLOAD && Engine::Instance().uploadQueue.IsComplete(ticket);
 }
 
 void Texture2D::setHorizontalWrapMode(GLenum mode)
@@ -104,11 +236,13 @@ void Texture2D::setMagFilter(GLenum filter)
 void Texture2D::CreateAsBuffer(GLenum bufferType, unsigned int width, unsigned int height)
 {
 	glGenTextures(1, &ID);
-	glBindTexture(GL_TEXTURE_2D, ID);
+	GLState::Instance().BindTexture(GL_TEXTURE_2D, ID);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// Filters sampling past the edge must not wrap around to the other side of the screen.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
 	glFramebufferTexture2D(bufferType, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ID, 0);
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <glad/glad.h>
 #include <glfw/glfw3.h>
@@ -13,6 +16,14 @@ enum class TextureType
 	SPECULAR
 };
 
+struct TextureRenderOption
+{
+	GLenum horizontalWrapMode = GL_REPEAT;
+	GLenum verticalWrapMode	  = GL_REPEAT;
+	GLenum minFilter		  = GL_LINEAR_MIPMAP_LINEAR;
+	GLenum magFilter		  = GL_LINEAR;
+};
+
 class Texture2D
 {
 public:
@@ -25,6 +36,12 @@ public:
 	std::string  path;
 
 	void use() const;
+	// Whether queued or still decoding uploads may write to the texture. Its name must not be deleted before.
+	// Render thread only.
+	bool isUploadPending() const;
+	// Whether the texture has data to sample. Asynchronously loaded textures only have allocated storage until their
+	// first upload has been issued. Render thread only.
+	bool isReady() const;
 
 	void setHorizontalWrapMode(GLenum mode);
 	void setVerticalWrapMode(GLenum mode);
@@ -34,6 +51,22 @@ public:
 	void CreateAsBuffer(GLenum bufferType, unsigned int width, unsigned int height);
 
 private:
+	// Loads the cooked version of the image, cooking it first if it is missing or stale.
+	bool loadCooked(const std::string& path, TextureInfo& info);
+
+	// Stands for an upload whose data is still being decoded.
+	static const uint64_t PENDING_UPLOAD = ~0ull;
+
+	// Upload queue tickets of the asynchronous upload, set by the decoding task and shared by copies of the texture.
+	struct UploadTickets
+	{
+		// The upload after which the texture can be sampled, PENDING_UPLOAD for good if the data cannot be read.
+		std::atomic<uint64_t> ready	{ PENDING_UPLOAD };
+		// The last upload writing to the texture, 0 if nothing was queued.
+		std::atomic<uint64_t> last	{ PENDING_UPLOAD };
+	};
+	std::shared_ptr<UploadTickets> uploadTickets;
+
 	GLenum horizontalWrapMode;
 	GLenum verticalWrapMode;
 	GLenum minFilter;
@@ -0,0 +1,261 @@
+#include "TextureCache.h"
+#include "GLState.h"
+#include "Engine.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+
+TextureHandle::TextureHandle(TextureCache* Cache, int Index)
+	: cache{ Cache }, index{ Index }
+{
+	cache->AddReference(index);
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other)
+	: cache{ other.cache }, index{ other.index }
+{
+	if (cache)
+		cache->AddReference(index);
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other) noexcept
+	: cache{ other.cache }, index{ other.index }
+{
+	other.cache = nullptr;
+	other.index = -1;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle other) noexcept
+{
+	std::swap(cache, other.cache);
+	std::swap(index, other.index);
+	return *this;
+}
+
+TextureHandle::~TextureHandle()
+{
+	Reset();
+}
+
+bool TextureHandle::IsValid() const
+{
+	return cache != nullptr;
+}
+
+Texture2D& TextureHandle::Get() const
+{
+	return cache->entries[index].texture;
+}
+
+Texture2D* TextureHandle::operator->() const
+{
+	return &Get();
+}
+
+void TextureHandle::Reset()
+{
+	if (cache)
+		cache->Release(index);
+	cache = nullptr;
+	index = -1;
+}
+
+TextureHandle TextureCache::Load(const std::string& path, TextureInfo& info)
+{
+	std::string canonicalPath = CanonicalPath(path);
+	auto found = byPath.find(canonicalPath);
+	if (found != byPath.end())
+	{
+		++pathHits;
+		info = entries[found->second].info;
+		return TextureHandle(this, found->second);
+	}
+
+	// A different path to the same file contents, for example a texture copied next to every model using it.
+	uint64_t hash = 0;
+	bool hashed = HashFile(path, hash);
+	if (hashed)
+	{
+		auto same = byContent.find(hash);
+		if (same != byContent.end())
+		{
+			Entry& entry = entries[same->second];
+			std::cout << "Texture at path: '" << path << "' is identical to '" << entry.paths.front() << "', sharing it." << std::endl;
+			++contentHits;
+			entry.paths.push_back(canonicalPath);
+			byPath[canonicalPath] = same->second;
+			info = entry.info;
+			return TextureHandle(this, same->second);
+		}
+	}
+
+	Texture2D texture;
+	TextureInfo loadedInfo;
+	if (!texture.load(path, loadedInfo))
+		return TextureHandle();
+
+	int index = Insert(texture);
+	Entry& entry = entries[index];
+	entry.info = loadedInfo;
+	entry.paths.push_back(canonicalPath);
+	byPath[canonicalPath] = index;
+	if (hashed)
+	{
+		entry.hashed = true;
+		entry.contentHash = hash;
+		byContent[hash] = index;
+	}
+	info = loadedInfo;
+	return TextureHandle(this, index);
+}
+
+void TextureCache::Prepare(const std::string& path)
+{
+	Engine& engine = Engine::Instance();
+	if (!engine.COOK_TEXTURES)
+		return;
+
+	// Models sharing a texture would otherwise cook it into the same file at once, so each cooked file is claimed
+	// while it is checked and cooked. Different textures are checked and cooked in parallel.
+	static std::mutex cookMutex;
+	static std::condition_variable cookFinished;
+	static std::unordered_set<std::string> cooking;
+	std::string cookedPath = TextureCooker::GetCookedPath(path);
+	{
+		std::unique_lock<std::mutex> lock(cookMutex);
+		cookFinished.wait(lock, [&cookedPath]() { return cooking.count(cookedPath) == 0; });
+		cooking.insert(cookedPath);
+	}
+
+	if (!TextureCooker::IsUpToDate(path, cookedPath, engine.textureCookSettings))
+		TextureCooker::Cook(path, cookedPath, engine.textureCookSettings, engine.threadPool);
+
+	{
+		std::lock_guard<std::mutex> lock(cookMutex);
+		cooking.erase(cookedPath);
+	}
+	cookFinished.notify_all();
+}
+
+TextureHandle TextureCache::Add(const Texture2D& texture)
+{
+	return TextureHandle(this, Insert(texture));
+}
+
+size_t TextureCache::GetTextureCount() const
+{
+	return textureCount;
+}
+
+unsigned int TextureCache::GetPathHits() const
+{
+	return pathHits;
+}
+
+unsigned int TextureCache::GetContentHits() const
+{
+	return contentHits;
+}
+
+int TextureCache::Insert(const Texture2D& texture)
+{
+	int index;
+	if (!freeEntries.empty())
+	{
+		index = freeEntries.back();
+		freeEntries.pop_back();
+		entries[index] = Entry();
+	}
+	else
+	{
+		index = int(entries.size());
+		entries.emplace_back();
+	}
+	entries[index].texture = texture;
+	++textureCount;
+	return index;
+}
+
+void TextureCache::AddReference(int index)
+{
+	++entries[index].references;
+}
+
+void TextureCache::Release(int index)
+{
+	Entry& entry = entries[index];
+	if (--entry.references > 0)
+		return;
+
+	// Deleting the name now would let queued uploads write into it, or into a texture that reuses it.
+	if (entry.texture.isUploadPending())
+		released.push_back(entry.texture);
+	else
+		GLState::Instance().DeleteTextures(1, &entry.texture.ID);
+	for (const std::string& path : entry.paths)
+		byPath.erase(path);
+	if (entry.hashed)
+		byContent.erase(entry.contentHash);
+	entries[index] = Entry();
+	freeEntries.push_back(index);
+	--textureCount;
+}
+
+void TextureCache::CollectReleased()
+{
+	auto done = std::remove_if(released.begin(), released.end(), [](Texture2D& texture)
+	{
+		if (texture.isUploadPending())
+			return false;
+		GLState::Instance().DeleteTextures(1, &texture.ID);
+		return true;
+	});
+	released.erase(done, released.end());
+}
+
+std::string TextureCache::CanonicalPath(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+	return error ? path : canonical.generic_string();
+}
+
+bool TextureCache::HashFile(const std::string& path, uint64_t& hash)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	hash = 14695981039346656037ull;
+	char buffer[64 * 1024];
+	while (file)
+	{
+		file.read(buffer, sizeof(buffer));
+		std::streamsize count = file.gcount();
+		for (std::streamsize i = 0; i < count; ++i)
+		{
+			hash ^= (unsigned char)buffer[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	return true;
+}
+
+TextureCache::~TextureCache()
+{
+	// Textures still referenced, by handles that outlive the cache's users.
+	for (Entry& entry : entries)
+	{
+		if (entry.references > 0)
+			GLState::Instance().DeleteTextures(1, &entry.texture.ID);
+	}
+	for (Texture2D& texture : released)
+		GLState::Instance().DeleteTextures(1, &texture.ID);
+}
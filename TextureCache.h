@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Texture2D.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TextureCache;
+
+// Counted reference to a texture of a TextureCache. Copies share the texture, which is deleted once the last handle
+// to it is gone. Handles must not outlive their cache.
+class TextureHandle
+{
+public:
+	TextureHandle() = default;
+	TextureHandle(const TextureHandle& other);
+	TextureHandle(TextureHandle&& other) noexcept;
+	TextureHandle& operator=(TextureHandle other) noexcept;
+	~TextureHandle();
+
+	bool       IsValid() const;
+	// Valid until the next texture is added to the cache.
+	Texture2D& Get() const;
+	Texture2D* operator->() const;
+
+	void       Reset();
+
+private:
+	friend class TextureCache;
+	TextureHandle(TextureCache* Cache, int Index);
+
+	TextureCache* cache	= nullptr;
+	int           index	= -1;
+};
+
+// Engine-wide registry of textures. Images are looked up by canonical path and then by a hash of the file's
+// contents, so a file referenced through different relative paths, or copied next to several models, is loaded
+// once. Render targets are registered too, without a path, so all textures are owned in one place. Render thread
+// only, like the GL calls it makes.
+class TextureCache
+{
+public:
+	~TextureCache();
+
+	// Returns an invalid handle if the image cannot be loaded. info is filled from the first load of the image.
+	TextureHandle Load(const std::string& path, TextureInfo& info);
+	// Thread safe. Cooks the image ahead of Load() if textures are cooked and its cooked file is missing or stale.
+	static void   Prepare(const std::string& path);
+	// Takes ownership of an already created texture.
+	TextureHandle Add(const Texture2D& texture);
+
+	// Textures currently alive.
+	size_t        GetTextureCount() const;
+	// Deletes released textures whose asynchronous uploads have been issued since. Call once per frame.
+	void          CollectReleased();
+
+	// Loads answered with an existing texture, by path and by contents.
+	unsigned int  GetPathHits() const;
+	unsigned int  GetContentHits() const;
+
+private:
+	friend class TextureHandle;
+
+	struct Entry
+	{
+		Texture2D                texture;
+		TextureInfo              info;
+		unsigned int             references	= 0;
+		bool                     hashed		= false;
+		uint64_t                 contentHash	= 0;
+		// Canonical paths leading to this entry.
+		std::vector<std::string> paths;
+	};
+
+	std::vector<Entry>                        entries;
+	std::vector<int>                          freeEntries;
+	std::unordered_map<std::string, int>      byPath;
+	std::unordered_map<uint64_t, int>         byContent;
+	// Textures without handles that uploads may still write to, deleted by CollectReleased().
+	std::vector<Texture2D>                    released;
+	size_t                                    textureCount	= 0;
+	unsigned int                              pathHits		= 0;
+	unsigned int                              contentHits		= 0;
+
+	int           Insert(const Texture2D& texture);
+	void          AddReference(int index);
+	void          Release(int index);
+
+	static std::string CanonicalPath(const std::string& path);
+	// FNV-1a over the file's bytes. Returns false if the file cannot be read.
+	static bool   HashFile(const std::string& path, uint64_t& hash);
+};
@@ -0,0 +1,512 @@
+#include "TextureCooker.h"
+#include "Engine.h"
+#include "ThreadPool.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COOKER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const uint32_t COOKED_MAGIC		= 0x58455443; // "CTEX"
+	const uint32_t COOKED_VERSION	= 1;
+
+	struct CookedHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		// Requested settings and S3TC support, see SettingsKey().
+		uint32_t settings;
+		uint32_t internalFormat;
+		uint32_t compressed;
+		uint32_t alphaChannel;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		uint32_t reserved;
+		uint64_t sourceSize;
+		int64_t  sourceTime;
+	};
+
+	uint32_t SettingsKey(const TextureCookSettings& settings, bool s3tc)
+	{
+		return uint32_t(settings.encoding) | uint32_t(settings.mipFilter) << 8 | uint32_t(s3tc) << 16;
+	}
+
+	bool SourceStamp(const std::string& path, uint64_t& size, int64_t& time)
+	{
+		std::error_code error;
+		size = std::filesystem::file_size(path, error);
+		if (error)
+			return false;
+		time = int64_t(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		return !error;
+	}
+
+	// Mip filters
+	// -------------------------------------------------------------------------------------------
+
+	void BoxFilterRow(const unsigned char* source, unsigned int sourceWidth, unsigned int sourceHeight, unsigned char* destination,
+		unsigned int width, unsigned int y)
+	{
+		const unsigned char* row0 = source + size_t(std::min(2 * y, sourceHeight - 1)) * sourceWidth * 4;
+		const unsigned char* row1 = source + size_t(std::min(2 * y + 1, sourceHeight - 1)) * sourceWidth * 4;
+		unsigned char* out = destination + size_t(y) * width * 4;
+
+		unsigned int x = 0;
+#ifdef TEXTURE_COOKER_SSE
+		// Two destination texels from four source texels of each row.
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16(2);
+		for (; x + 1 < width && 2 * x + 3 < sourceWidth; x += 2)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + 8 * x));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + 8 * x));
+			__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+			high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+			__m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), rounding), 2);
+			_mm_storel_epi64((__m128i*)(out + 4 * x), _mm_packus_epi16(sum, sum));
+		}
+#endif
+		for (; x < width; ++x)
+		{
+			unsigned int x0 = std::min(2 * x, sourceWidth - 1), x1 = std::min(2 * x + 1, sourceWidth - 1);
+			for (unsigned int c = 0; c < 4; ++c)
+				out[4 * x + c] = (unsigned char)((row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c] + 2) >> 2);
+		}
+	}
+
+	double BesselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; ++k)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Weights of the source texels around each destination texel when halving a dimension, normalized to 1.
+	struct KaiserKernel
+	{
+		static const int RADIUS	= 6;
+		float            weights[2 * RADIUS];
+
+		KaiserKernel()
+		{
+			const double width = 3.0, beta = 4.0;
+			double sum = 0.0;
+			for (int i = 0; i < 2 * RADIUS; ++i)
+			{
+				// Distance of the source texel center from the destination texel center, in destination texels.
+				double t = (double(i - RADIUS) + 0.5) / 2.0;
+				double sinc = std::fabs(t) < 1e-9 ? 1.0 : std::sin(3.14159265358979 * t) / (3.14159265358979 * t);
+				double x = t / width;
+				double window = std::fabs(x) < 1.0 ? BesselI0(beta * std::sqrt(1.0 - x * x)) / BesselI0(beta) : 0.0;
+				weights[i] = float(sinc * window);
+				sum += weights[i];
+			}
+			for (float& weight : weights)
+				weight = float(weight / sum);
+		}
+	};
+
+	void KaiserDownsample(const std::vector<unsigned char>& source, unsigned int sourceWidth, unsigned int sourceHeight,
+		std::vector<unsigned char>& destination, unsigned int width, unsigned int height, ThreadPool& threadPool)
+	{
+		static const KaiserKernel kernel;
+		const int radius = KaiserKernel::RADIUS;
+
+		// Horizontal pass into floats, then the vertical pass. Texels past the edges are clamped.
+		std::vector<float> horizontal(size_t(width) * sourceHeight * 4);
+		threadPool.ParallelFor(sourceHeight, [&](unsigned int y)
+		{
+			const unsigned char* row = source.data() + size_t(y) * sourceWidth * 4;
+			float* out = horizontal.data() + size_t(y) * width * 4;
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				float sum[4] = {};
+				for (int i = 0; i < 2 * radius; ++i)
+				{
+					int sx = std::clamp(int(2 * x) + i - radius + 1, 0, int(sourceWidth) - 1);
+					for (unsigned int c = 0; c < 4; ++c)
+						sum[c] += kernel.weights[i] * row[4 * sx + c];
+				}
+				std::memcpy(out + 4 * x, sum, sizeof(sum));
+			}
+		});
+
+		destination.resize(size_t(width) * height * 4);
+		threadPool.ParallelFor(height, [&](unsigned int y)
+		{
+			unsigned char* out = destination.data() + size_t(y) * width * 4;
+			for (unsigned int x = 0; x < width * 4; ++x)
+			{
+				float sum = 0.0f;
+				for (int i = 0; i < 2 * radius; ++i)
+				{
+					int sy = std::clamp(int(2 * y) + i - radius + 1, 0, int(sourceHeight) - 1);
+					sum += kernel.weights[i] * horizontal[size_t(sy) * width * 4 + x];
+				}
+				out[x] = (unsigned char)std::clamp(int(sum + 0.5f), 0, 255);
+			}
+		});
+	}
+
+	// Block encoders
+	// -------------------------------------------------------------------------------------------
+
+	uint16_t To565(const unsigned char* color)
+	{
+		return uint16_t((color[0] >> 3) << 11 | (color[1] >> 2) << 5 | (color[2] >> 3));
+	}
+
+	void From565(uint16_t packed, int* color)
+	{
+		color[0] = (packed >> 11 & 31) * 255 / 31;
+		color[1] = (packed >> 5 & 63) * 255 / 63;
+		color[2] = (packed & 31) * 255 / 31;
+	}
+
+	// Color block of BC1 and BC3 from the bounding box of the block's colors, inset by 1/16 against outliers.
+	// Always the four color mode.
+	void EncodeColorBlock(const unsigned char block[16][4], unsigned char* out)
+	{
+		unsigned char minColor[3] = { 255, 255, 255 }, maxColor[3] = { 0, 0, 0 };
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			for (unsigned int c = 0; c < 3; ++c)
+			{
+				minColor[c] = std::min(minColor[c], block[i][c]);
+				maxColor[c] = std::max(maxColor[c], block[i][c]);
+			}
+		}
+		for (unsigned int c = 0; c < 3; ++c)
+		{
+			int inset = (maxColor[c] - minColor[c]) >> 4;
+			minColor[c] = (unsigned char)std::min(255, minColor[c] + inset);
+			maxColor[c] = (unsigned char)std::max(0, maxColor[c] - inset);
+		}
+
+		uint16_t color0 = To565(maxColor), color1 = To565(minColor);
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			From565(color0, palette[0]);
+			From565(color1, palette[1]);
+			for (unsigned int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (unsigned int i = 0; i < 16; ++i)
+			{
+				int best = 0, bestDistance = 1 << 30;
+				for (int p = 0; p < 4; ++p)
+				{
+					int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= uint32_t(best) << (2 * i);
+			}
+		}
+
+		std::memcpy(out, &color0, 2);
+		std::memcpy(out + 2, &color1, 2);
+		std::memcpy(out + 4, &indices, 4);
+	}
+
+	// One channel block of BC3 alpha and BC4/BC5, in the eight value mode.
+	void EncodeChannelBlock(const unsigned char block[16][4], unsigned int channel, unsigned char* out)
+	{
+		unsigned char minValue = 255, maxValue = 0;
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			minValue = std::min(minValue, block[i][channel]);
+			maxValue = std::max(maxValue, block[i][channel]);
+		}
+
+		int palette[8];
+		palette[0] = maxValue;
+		palette[1] = minValue;
+		for (int p = 1; p < 7; ++p)
+			palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+
+		uint64_t indices = 0;
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			int best = 0, bestDistance = 256;
+			for (int p = 0; p < 8; ++p)
+			{
+				int distance = std::abs(int(block[i][channel]) - palette[p]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= uint64_t(best) << (3 * i);
+		}
+
+		out[0] = maxValue;
+		out[1] = minValue;
+		for (unsigned int b = 0; b < 6; ++b)
+			out[2 + b] = (unsigned char)(indices >> (8 * b));
+	}
+
+	size_t BlockBytes(TextureEncoding encoding)
+	{
+		return encoding == TextureEncoding::BC1 ? 8 : 16;
+	}
+}
+
+std::string TextureCooker::GetCookedPath(const std::string& sourcePath)
+{
+	return Engine::GetCachePath(sourcePath, ".ctex");
+}
+
+bool TextureCooker::IsUpToDate(const std::string& sourcePath, const std::string& cookedPath, const TextureCookSettings& settings)
+{
+	std::ifstream file(cookedPath, std::ios::binary);
+	CookedHeader header;
+	if (!file || !file.read((char*)&header, sizeof(header)))
+		return false;
+
+	uint64_t size;
+	int64_t time;
+	if (!SourceStamp(sourcePath, size, time))
+		return false;
+	return header.magic == COOKED_MAGIC && header.version == COOKED_VERSION && header.settings == SettingsKey(settings, IsS3tcSupported())
+		&& header.sourceSize == size && header.sourceTime == time;
+}
+
+bool TextureCooker::Cook(const std::string& sourcePath, const std::string& cookedPath, const TextureCookSettings& settings,
+	ThreadPool& threadPool)
+{
+	int width, height, nrChannels;
+	unsigned char* data = stbi_load(sourcePath.c_str(), &width, &height, &nrChannels, 4);
+	if (!data)
+	{
+		std::cerr << "Failed to load texture from path '" << sourcePath << "'" << std::endl;
+		return false;
+	}
+	std::vector<unsigned char> pixels(data, data + size_t(width) * height * 4);
+	stbi_image_free(data);
+
+	bool s3tc = IsS3tcSupported();
+	TextureEncoding encoding = settings.encoding;
+	if (encoding == TextureEncoding::AUTO)
+	{
+		bool opaque = true;
+		for (size_t i = 3; i < pixels.size() && opaque; i += 4)
+			opaque = pixels[i] == 255;
+		encoding = opaque ? TextureEncoding::BC1 : TextureEncoding::BC3;
+	}
+	if (!s3tc && (encoding == TextureEncoding::BC1 || encoding == TextureEncoding::BC3))
+		encoding = TextureEncoding::RGBA8;
+
+	std::vector<std::vector<unsigned char>> levels = GenerateMipChain(pixels, width, height, settings.mipFilter, threadPool);
+
+	CookedHeader header = {};
+	header.magic = COOKED_MAGIC;
+	header.version = COOKED_VERSION;
+	header.settings = SettingsKey(settings, s3tc);
+	header.compressed = encoding != TextureEncoding::RGBA8;
+	header.alphaChannel = nrChannels == 4;
+	header.width = width;
+	header.height = height;
+	header.levelCount = (uint32_t)levels.size();
+	switch (encoding)
+	{
+	case TextureEncoding::BC1:	header.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+	case TextureEncoding::BC3:	header.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+	case TextureEncoding::BC5:	header.internalFormat = GL_COMPRESSED_RG_RGTC2; break;
+	default:					header.internalFormat = GL_RGBA8; break;
+	}
+	if (!SourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+		return false;
+
+	if (!Engine::CreateCacheFolders(cookedPath))
+		return false;
+	std::ofstream file(cookedPath, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "ERROR::TEXTURE_COOKER::Could not write " << cookedPath << std::endl;
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+
+	size_t sourceBytes = 0, cookedBytes = 0;
+	unsigned int levelWidth = width, levelHeight = height;
+	for (const std::vector<unsigned char>& level : levels)
+	{
+		std::vector<unsigned char> encoded = encoding == TextureEncoding::RGBA8 ? level : Encode(level, levelWidth, levelHeight, encoding, threadPool);
+		uint32_t imageSize = (uint32_t)encoded.size();
+		file.write((const char*)&imageSize, sizeof(imageSize));
+		file.write((const char*)encoded.data(), encoded.size());
+		sourceBytes += level.size();
+		cookedBytes += encoded.size();
+		levelWidth = std::max(1u, levelWidth / 2);
+		levelHeight = std::max(1u, levelHeight / 2);
+	}
+
+	std::cout << "Texture '" << sourcePath << "' cooked: " << levels.size() << " levels, " << sourceBytes / 1024 << " KiB -> "
+		<< cookedBytes / 1024 << " KiB." << std::endl;
+	return bool(file);
+}
+
+bool TextureCooker::Load(const std::string& cookedPath, CookedTexture& texture, bool headerOnly)
+{
+	std::ifstream file(cookedPath, std::ios::binary);
+	CookedHeader header;
+	if (!file || !file.read((char*)&header, sizeof(header)) || header.magic != COOKED_MAGIC || header.version != COOKED_VERSION)
+	{
+		std::cout << "ERROR::TEXTURE_COOKER::Could not read " << cookedPath << std::endl;
+		return false;
+	}
+
+	texture.internalFormat = header.internalFormat;
+	texture.compressed = header.compressed != 0;
+	texture.alphaChannel = header.alphaChannel != 0;
+	texture.width = header.width;
+	texture.height = header.height;
+	texture.levelCount = header.levelCount;
+	if (headerOnly)
+		return true;
+
+	texture.levels.resize(header.levelCount);
+	for (std::vector<unsigned char>& level : texture.levels)
+	{
+		uint32_t imageSize;
+		if (!file.read((char*)&imageSize, sizeof(imageSize)))
+			break;
+		level.resize(imageSize);
+		file.read((char*)level.data(), imageSize);
+	}
+	if (!file)
+	{
+		std::cout << "ERROR::TEXTURE_COOKER::Truncated file " << cookedPath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+size_t TextureCooker::GetLevelSize(GLenum internalFormat, unsigned int width, unsigned int height)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		return size_t((width + 3) / 4) * ((height + 3) / 4) * 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:
+		return size_t((width + 3) / 4) * ((height + 3) / 4) * 16;
+	default:
+		return size_t(width) * height * 4;
+	}
+}
+
+bool TextureCooker::IsS3tcSupported()
+{
+	static const bool supported = []()
+	{
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint i = 0; i < extensionCount; ++i)
+		{
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+				return true;
+		}
+		return false;
+	}();
+	return supported;
+}
+
+std::vector<std::vector<unsigned char>> TextureCooker::GenerateMipChain(const std::vector<unsigned char>& pixels, unsigned int width,
+	unsigned int height, MipFilter filter, ThreadPool& threadPool)
+{
+	std::vector<std::vector<unsigned char>> levels;
+	levels.push_back(pixels);
+	while (width > 1 || height > 1)
+	{
+		unsigned int nextWidth = std::max(1u, width / 2), nextHeight = std::max(1u, height / 2);
+		std::vector<unsigned char> next;
+		if (filter == MipFilter::KAISER)
+			KaiserDownsample(levels.back(), width, height, next, nextWidth, nextHeight, threadPool);
+		else
+		{
+			next.resize(size_t(nextWidth) * nextHeight * 4);
+			const std::vector<unsigned char>& source = levels.back();
+			threadPool.ParallelFor(nextHeight, [&](unsigned int y)
+			{
+				BoxFilterRow(source.data(), width, height, next.data(), nextWidth, y);
+			});
+		}
+		levels.push_back(std::move(next));
+		width = nextWidth;
+		height = nextHeight;
+	}
+	return levels;
+}
+
+std::vector<unsigned char> TextureCooker::Encode(const std::vector<unsigned char>& pixels, unsigned int width, unsigned int height,
+	TextureEncoding encoding, ThreadPool& threadPool)
+{
+	unsigned int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockBytes = BlockBytes(encoding);
+	std::vector<unsigned char> encoded(size_t(blocksX) * blocksY * blockBytes);
+
+	threadPool.ParallelFor(blocksY, [&](unsigned int blockY)
+	{
+		for (unsigned int blockX = 0; blockX < blocksX; ++blockX)
+		{
+			// Blocks hanging over the edge repeat the last row and column.
+			unsigned char block[16][4];
+			for (unsigned int i = 0; i < 16; ++i)
+			{
+				unsigned int x = std::min(blockX * 4 + i % 4, width - 1), y = std::min(blockY * 4 + i / 4, height - 1);
+				std::memcpy(block[i], &pixels[(size_t(y) * width + x) * 4], 4);
+			}
+
+			unsigned char* out = &encoded[(size_t(blockY) * blocksX + blockX) * blockBytes];
+			switch (encoding)
+			{
+			case TextureEncoding::BC1:
+				EncodeColorBlock(block, out);
+				break;
+			case TextureEncoding::BC3:
+				EncodeChannelBlock(block, 3, out);
+				EncodeColorBlock(block, out + 8);
+				break;
+			case TextureEncoding::BC5:
+				EncodeChannelBlock(block, 0, out);
+				EncodeChannelBlock(block, 1, out + 8);
+				break;
+			default:
+				break;
+			}
+		}
+	});
+	return encoded;
+}
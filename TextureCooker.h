@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// EXT_texture_compression_s3tc is not part of the loader's core profile.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT		0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	0x83F3
+#endif
+
+enum class TextureEncoding
+{
+	// BC1, or BC3 if any texel is not opaque. RGBA8 if the driver lacks S3TC.
+	AUTO,
+	RGBA8,
+	// S3TC DXT1, 0.5 bytes per texel, opaque.
+	BC1,
+	// S3TC DXT5, 1 byte per texel, with alpha.
+	BC3,
+	// RGTC2, 1 byte per texel, two channels. For normal maps.
+	BC5
+};
+
+enum class MipFilter
+{
+	// 2x2 average.
+	BOX,
+	// Kaiser windowed sinc, sharper than the box filter at the cost of a wider kernel.
+	KAISER
+};
+
+struct TextureCookSettings
+{
+	TextureEncoding encoding	= TextureEncoding::AUTO;
+	MipFilter       mipFilter	= MipFilter::BOX;
+};
+
+struct CookedTexture
+{
+	GLenum                                  internalFormat	= GL_RGBA8;
+	bool                                    compressed		= false;
+	// Whether the source image had an alpha channel.
+	bool                                    alphaChannel	= false;
+	unsigned int                            width			= 0;
+	unsigned int                            height			= 0;
+	unsigned int                            levelCount		= 0;
+	// Level 0 first.
+	std::vector<std::vector<unsigned char>> levels;
+};
+
+// Turns images into textures ready for the GPU: a full mip chain built on the CPU and, unless disabled, block
+// compressed texels. Results are stored as "<source>.ctex" under Engine::CACHE_DIRECTORY, a container modeled on
+// KTX: a fixed header followed by the size and data of each level. The header records the source file's size and
+// modification time and the settings, so stale files are cooked again. Mip levels are filtered and encoded on the
+// thread pool.
+class TextureCooker
+{
+public:
+	static std::string GetCookedPath(const std::string& sourcePath);
+	// Whether the cooked file exists and matches the source and the settings.
+	static bool        IsUpToDate(const std::string& sourcePath, const std::string& cookedPath, const TextureCookSettings& settings);
+	static bool        Cook(const std::string& sourcePath, const std::string& cookedPath, const TextureCookSettings& settings,
+		ThreadPool& threadPool);
+	// Reads only the header if headerOnly is set, leaving levels empty.
+	static bool        Load(const std::string& cookedPath, CookedTexture& texture, bool headerOnly = false);
+	// Bytes of a level in the given format, which is GL_RGBA8 or a compressed format.
+	static size_t      GetLevelSize(GLenum internalFormat, unsigned int width, unsigned int height);
+
+	// Requires a current context on the first call, which caches the result.
+	static bool        IsS3tcSupported();
+
+	// Exposed for tools. pixels is RGBA8, the result holds every level including level 0.
+	static std::vector<std::vector<unsigned char>> GenerateMipChain(const std::vector<unsigned char>& pixels, unsigned int width,
+		unsigned int height, MipFilter filter, ThreadPool& threadPool);
+	static std::vector<unsigned char> Encode(const std::vector<unsigned char>& pixels, unsigned int width, unsigned int height,
+		TextureEncoding encoding, ThreadPool& threadPool);
+};
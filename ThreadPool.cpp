@@ -0,0 +1,110 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int ThreadCount)
+{
+	if (ThreadCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		ThreadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < ThreadCount; ++i)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		task();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--pendingTasks == 0)
+			tasksFinished.notify_all();
+	}
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push(std::move(task));
+		++pendingTasks;
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	tasksFinished.wait(lock, [this]() { return pendingTasks == 0; });
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& task)
+{
+	if (count == 0)
+		return;
+
+	// Indices are handed out one at a time, so uneven items balance themselves.
+	struct Job
+	{
+		std::atomic<unsigned int> next		{ 0 };
+		std::atomic<unsigned int> done		{ 0 };
+		std::mutex                mutex;
+		std::condition_variable   finished;
+	};
+	auto job = std::make_shared<Job>();
+
+	auto run = [job, count, &task]()
+	{
+		unsigned int completed = 0;
+		for (unsigned int i = job->next++; i < count; i = job->next++)
+		{
+			task(i);
+			++completed;
+		}
+		if (completed > 0 && (job->done += completed) == count)
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->finished.notify_all();
+		}
+	};
+
+	unsigned int helpers = std::min(count - 1, (unsigned int)workers.size());
+	for (unsigned int i = 0; i < helpers; ++i)
+		Enqueue(run);
+	run();
+
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->finished.wait(lock, [&job, count]() { return job->done == count; });
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return (unsigned int)workers.size();
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU-side frame work. Tasks must not touch GL, the context belongs to the main thread.
+class ThreadPool
+{
+public:
+	// 0 uses one worker per hardware thread, minus the main thread.
+	explicit ThreadPool(unsigned int ThreadCount = 0);
+	~ThreadPool();
+	ThreadPool(ThreadPool const&) = delete;
+	void operator=(ThreadPool const&) = delete;
+
+	void         Enqueue(std::function<void()> task);
+	// Blocks until every enqueued task has finished.
+	void         Wait();
+	// Runs task(i) for every i in [0, count) on the workers and the calling thread, and returns when all are done.
+	void         ParallelFor(unsigned int count, const std::function<void(unsigned int)>& task);
+
+	unsigned int GetThreadCount() const;
+
+private:
+	std::vector<std::thread>          workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex                        mutex;
+	std::condition_variable           taskAvailable;
+	std::condition_variable           tasksFinished;
+	unsigned int                      pendingTasks	= 0;
+	bool                              stopping		= false;
+
+	void WorkerLoop();
+};
@@ -0,0 +1,80 @@
+#include "TransparentQueue.h"
+
+#include <cstring>
+#include <utility>
+
+void TransparentQueue::Clear()
+{
+	// Keeps capacity, so the next frame reuses the same memory.
+	items.clear();
+}
+
+void TransparentQueue::Push(float viewDepth, uint32_t entityIndex, uint32_t meshIndex)
+{
+	items.push_back({ QuantizeDepth(viewDepth), entityIndex, meshIndex });
+}
+
+void TransparentQueue::Sort()
+{
+	if (items.size() < 2)
+		return;
+
+	if (scratch.size() < items.size())
+		scratch.resize(items.size());
+
+	TransparentItem* source = items.data();
+	TransparentItem* destination = scratch.data();
+	size_t count = items.size();
+
+	// LSD radix sort, one byte per pass. Stable, so items at equal depth keep submission order.
+	for (unsigned int shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t histogram[256] = { 0 };
+		for (size_t i = 0; i < count; ++i)
+		{
+			++histogram[(source[i].sortKey >> shift) & 0xFF];
+		}
+
+		// Skip passes where every key has the same byte.
+		if (histogram[(source[0].sortKey >> shift) & 0xFF] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (unsigned int bucket = 0; bucket < 256; ++bucket)
+		{
+			uint32_t bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			destination[histogram[(source[i].sortKey >> shift) & 0xFF]++] = source[i];
+		}
+
+		std::swap(source, destination);
+	}
+
+	if (source != items.data())
+		std::memcpy(items.data(), source, count * sizeof(TransparentItem));
+}
+
+const std::vector<TransparentItem>& TransparentQueue::GetItems() const
+{
+	return items;
+}
+
+size_t TransparentQueue::Size() const
+{
+	return items.size();
+}
+
+uint32_t TransparentQueue::QuantizeDepth(float viewDepth)
+{
+	// Map the float to an unsigned integer with the same ordering, then invert it
+	// so that ascending keys mean far to near.
+	uint32_t bits;
+	std::memcpy(&bits, &viewDepth, sizeof(float));
+	uint32_t mask = (bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+	return ~(bits ^ mask);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct TransparentItem
+{
+	uint32_t sortKey;
+	// Index into the entity manager's entity vector for this frame.
+	uint32_t entityIndex;
+	// Mesh of the entity's model to draw, or TransparentQueue::ALL_MESHES.
+	uint32_t meshIndex;
+};
+
+// Per-frame list of transparent draws, sorted back to front with a radix sort on quantized view depth.
+// Storage is reused across frames, so once warmed up neither pushing nor sorting allocates.
+class TransparentQueue
+{
+public:
+	static const uint32_t ALL_MESHES = 0xFFFFFFFF;
+
+	void Clear();
+	void Push(float viewDepth, uint32_t entityIndex, uint32_t meshIndex = ALL_MESHES);
+	void Sort();
+
+	const std::vector<TransparentItem>& GetItems() const;
+	size_t Size() const;
+
+private:
+	std::vector<TransparentItem> items;
+	std::vector<TransparentItem> scratch;
+
+	static uint32_t QuantizeDepth(float viewDepth);
+};
@@ -0,0 +1,372 @@
+#include "UploadQueue.h"
+#include "GLState.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+UploadQueue::UploadQueue(size_t StagingSize)
+	: stagingSize{ StagingSize }
+{}
+
+void UploadQueue::Generate()
+{
+	// Regions start on a four byte boundary, which is also the unpack alignment of the staged rows.
+	regionSize = stagingSize / FRAMES_IN_FLIGHT & ~size_t(3);
+
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_COPY_READ_BUFFER, ID);
+	glBufferData(GL_COPY_READ_BUFFER, regionSize * FRAMES_IN_FLIGHT, NULL, GL_STREAM_COPY);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+uint64_t UploadQueue::UploadTexture(unsigned int texture, unsigned int level, int width, int height, GLenum format,
+	std::vector<unsigned char> data, TextureCompletion completion)
+{
+	Request request;
+	request.destination = texture;
+	request.offset = 0;
+	request.level = level;
+	request.width = width;
+	request.height = height;
+	request.format = format;
+	request.completion = completion;
+	request.data = std::move(data);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	request.ticket = nextTicket++;
+	incomingBytes += request.data.size();
+	incoming.push_back(std::move(request));
+	return nextTicket - 1;
+}
+
+uint64_t UploadQueue::UploadBuffer(unsigned int buffer, size_t offset, std::vector<unsigned char> data)
+{
+	Request request;
+	request.destination = buffer;
+	request.offset = offset;
+	request.data = std::move(data);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	request.ticket = nextTicket++;
+	incomingBytes += request.data.size();
+	incoming.push_back(std::move(request));
+	return nextTicket - 1;
+}
+
+void UploadQueue::Process(size_t budget)
+{
+	uploadedBytes = 0;
+	TakeIncoming();
+	if (active.empty() || budget == 0)
+		return;
+
+	if (!ProcessRegion(std::min(budget, regionSize), false))
+		++deferredFrames;
+}
+
+void UploadQueue::Flush()
+{
+	TakeIncoming();
+	while (!active.empty())
+		ProcessRegion(regionSize, true);
+}
+
+bool UploadQueue::ProcessRegion(size_t limit, bool wait)
+{
+	if (fences[frameIndex])
+	{
+		GLenum result = glClientWaitSync(fences[frameIndex], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			if (!wait)
+				return false;
+			do
+			{
+				result = glClientWaitSync(fences[frameIndex], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fences[frameIndex]);
+		fences[frameIndex] = 0;
+	}
+
+	if (!ID)
+	{
+		UploadAllDirect();
+		return true;
+	}
+
+	// A row wider than a whole region can never be staged.
+	while (!active.empty() && active.front().width && RowBytes(active.front()) > regionSize)
+	{
+		UploadDirect(active.front());
+		Finish(active.front());
+		active.pop_front();
+	}
+	if (active.empty())
+		return true;
+
+	// Always make progress on the first request, even if one of its rows is larger than the budget.
+	if (active.front().width)
+		limit = std::max(limit, (RowBytes(active.front()) + 3) & ~size_t(3));
+	limit &= ~size_t(3);
+
+	struct Chunk
+	{
+		Request* request;
+		size_t   stagingOffset;
+		// First row or byte, and the number of rows or bytes.
+		size_t   start;
+		size_t   count;
+	};
+	std::vector<Chunk> chunks;
+
+	const size_t regionStart = frameIndex * regionSize;
+	glBindBuffer(GL_COPY_READ_BUFFER, ID);
+	unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, regionStart, limit,
+		GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	if (!mapped)
+	{
+		std::cout << "ERROR::UPLOAD_QUEUE::Failed to map staging region " << frameIndex << ", uploading directly." << std::endl;
+		UploadAllDirect();
+		return true;
+	}
+
+	size_t head = 0;
+	for (Request& request : active)
+	{
+		if (request.width)
+		{
+			// Rows are padded to four bytes, so the copy out of the staging buffer takes the driver's fast path. Block
+			// rows always are a multiple of eight bytes.
+			size_t rowBytes = RowBytes(request);
+			size_t pitch = (rowBytes + 3) & ~size_t(3);
+			size_t rows = std::min(RowCount(request) - request.progress, (limit - head) / pitch);
+			if (rows == 0 && request.progress < RowCount(request))
+				break;
+			for (size_t row = 0; row < rows; ++row)
+				std::memcpy(mapped + head + row * pitch, request.data.data() + (request.progress + row) * rowBytes, rowBytes);
+			chunks.push_back({ &request, regionStart + head, request.progress, rows });
+			request.progress += rows;
+			head += rows * pitch;
+			uploadedBytes += rows * rowBytes;
+			activeBytes -= rows * rowBytes;
+		}
+		else
+		{
+			size_t bytes = std::min(request.data.size() - request.progress, limit - head);
+			if (bytes == 0 && request.progress < request.data.size())
+				break;
+			std::memcpy(mapped + head, request.data.data() + request.progress, bytes);
+			chunks.push_back({ &request, regionStart + head, request.progress, bytes });
+			request.progress += bytes;
+			head += (bytes + 3) & ~size_t(3);
+			uploadedBytes += bytes;
+			activeBytes -= bytes;
+		}
+		if (!IsDone(request))
+			break;
+	}
+	glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+	bool texturesCopied = false;
+	for (const Chunk& chunk : chunks)
+	{
+		const Request& request = *chunk.request;
+		if (chunk.count == 0)
+			continue;
+		if (request.width)
+		{
+			if (!texturesCopied)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ID);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+				texturesCopied = true;
+			}
+			GLState::Instance().BindTexture(GL_TEXTURE_2D, request.destination);
+			if (IsCompressed(request.format))
+			{
+				// The last block row may cover fewer texel rows than 4.
+				GLint y = GLint(chunk.start * 4);
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, request.level, 0, y, request.width, std::min(GLsizei(chunk.count * 4), request.height - y),
+					request.format, GLsizei(chunk.count * RowBytes(request)), (void*)chunk.stagingOffset);
+			}
+			else
+			{
+				glTexSubImage2D(GL_TEXTURE_2D, request.level, 0, GLint(chunk.start), request.width, GLsizei(chunk.count), request.format,
+					GL_UNSIGNED_BYTE, (void*)chunk.stagingOffset);
+			}
+		}
+		else
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, request.destination);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(chunk.stagingOffset),
+				GLintptr(request.offset + chunk.start), GLsizeiptr(chunk.count));
+		}
+	}
+	// Client memory uploads elsewhere expect no unpack buffer.
+	if (texturesCopied)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	while (!active.empty() && IsDone(active.front()))
+	{
+		Finish(active.front());
+		active.pop_front();
+	}
+
+	if (!chunks.empty())
+	{
+		fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
+	}
+	return true;
+}
+
+void UploadQueue::TakeIncoming()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	while (!incoming.empty())
+	{
+		active.push_back(std::move(incoming.front()));
+		incoming.pop_front();
+	}
+	activeBytes += incomingBytes;
+	incomingBytes = 0;
+}
+
+void UploadQueue::UploadDirect(Request& request)
+{
+	if (request.width)
+	{
+		size_t rowBytes = RowBytes(request);
+		size_t rows = RowCount(request) - request.progress;
+		GLState::Instance().BindTexture(GL_TEXTURE_2D, request.destination);
+		if (IsCompressed(request.format))
+		{
+			GLint y = GLint(request.progress * 4);
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, request.level, 0, y, request.width, request.height - y, request.format,
+				GLsizei(rows * rowBytes), request.data.data() + request.progress * rowBytes);
+		}
+		else
+		{
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage2D(GL_TEXTURE_2D, request.level, 0, GLint(request.progress), request.width, GLsizei(rows),
+				request.format, GL_UNSIGNED_BYTE, request.data.data() + request.progress * rowBytes);
+		}
+		activeBytes -= rows * rowBytes;
+		request.progress = RowCount(request);
+	}
+	else
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, request.destination);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(request.offset + request.progress), GLsizeiptr(request.data.size() - request.progress),
+			request.data.data() + request.progress);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		activeBytes -= request.data.size() - request.progress;
+		request.progress = request.data.size();
+	}
+}
+
+void UploadQueue::UploadAllDirect()
+{
+	for (Request& request : active)
+	{
+		UploadDirect(request);
+		Finish(request);
+	}
+	active.clear();
+}
+
+void UploadQueue::Finish(const Request& request)
+{
+	// Textures are limited to the levels they already have while they stream in.
+	if (request.width && request.completion == TextureCompletion::GENERATE_MIPMAPS)
+	{
+		GLState::Instance().BindTexture(GL_TEXTURE_2D, request.destination);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+	}
+	else if (request.width && request.completion == TextureCompletion::ENABLE_LEVELS)
+	{
+		GLState::Instance().BindTexture(GL_TEXTURE_2D, request.destination);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(request.level));
+	}
+	completedTicket = request.ticket;
+}
+
+bool UploadQueue::IsDone(const Request& request)
+{
+	return request.width ? request.progress >= RowCount(request) : request.progress >= request.data.size();
+}
+
+bool UploadQueue::IsCompressed(GLenum format)
+{
+	return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT || format == GL_COMPRESSED_RG_RGTC2;
+}
+
+size_t UploadQueue::RowCount(const Request& request)
+{
+	return IsCompressed(request.format) ? size_t(request.height + 3) / 4 : size_t(request.height);
+}
+
+size_t UploadQueue::RowBytes(const Request& request)
+{
+	if (IsCompressed(request.format))
+		return size_t(request.width + 3) / 4 * (request.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16);
+
+	size_t channels = 4;
+	switch (request.format)
+	{
+	case GL_RED:
+		channels = 1;
+		break;
+	case GL_RG:
+		channels = 2;
+		break;
+	case GL_RGB:
+		channels = 3;
+		break;
+	}
+	return size_t(request.width) * channels;
+}
+
+bool UploadQueue::IsComplete(uint64_t ticket) const
+{
+	return completedTicket >= ticket;
+}
+
+bool UploadQueue::IsIdle() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return active.empty() && incoming.empty();
+}
+
+size_t UploadQueue::GetUploadedBytes() const
+{
+	return uploadedBytes;
+}
+
+size_t UploadQueue::GetPendingBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return activeBytes + incomingBytes;
+}
+
+unsigned int UploadQueue::GetDeferredFrames() const
+{
+	return deferredFrames;
+}
+
+UploadQueue::~UploadQueue()
+{
+	for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	}
+	if (ID)
+		GLState::Instance().DeleteBuffers(1, &ID);
+}
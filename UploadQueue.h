@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// What happens once the upload of a texture level is done.
+enum class TextureCompletion
+{
+	NONE,
+	// Builds the lower levels from this one.
+	GENERATE_MIPMAPS,
+	// Lets sampling use every level down to this one, for levels uploaded from the smallest up.
+	ENABLE_LEVELS
+};
+
+// Streams texture and buffer data to the GPU through a staging buffer, a limited number of bytes per frame.
+// Requests can be queued from any thread, for example by loaders once they have decoded a file. The render thread
+// copies the front of the queue into one region of the staging buffer and issues glTexSubImage2D (through the pixel
+// unpack binding) or glCopyBufferSubData out of it. Like StreamingBuffer, a region is only reused once the fence of
+// the frame that last used it has signaled, but instead of waiting the queue skips the frame, so uploads never stall
+// rendering. Large textures are split by rows (of blocks, for compressed formats) and large buffers by bytes over as
+// many frames as the budget requires.
+class UploadQueue
+{
+public:
+	static const unsigned int FRAMES_IN_FLIGHT = 3;
+
+	explicit UploadQueue(size_t StagingSize);
+	~UploadQueue();
+
+	void     Generate();
+
+	// Thread safe. Uploads a level of a GL_TEXTURE_2D whose storage has already been allocated. format is GL_RED to
+	// GL_RGBA for tightly packed texels, or the compressed internal format of block compressed data. Returns a ticket
+	// for IsComplete().
+	uint64_t UploadTexture(unsigned int texture, unsigned int level, int width, int height, GLenum format,
+		std::vector<unsigned char> data, TextureCompletion completion);
+	// Thread safe. Copies data into the buffer at offset.
+	uint64_t UploadBuffer(unsigned int buffer, size_t offset, std::vector<unsigned char> data);
+
+	// Issues copies of at most budget bytes, limited to the size of a staging region. Render thread only.
+	void     Process(size_t budget);
+	// Issues every queued copy, waiting for staging regions as needed. Render thread only.
+	void     Flush();
+
+	// Whether the copies of the request and of all requests queued before it have been issued. Draws issued after
+	// that see the data.
+	bool     IsComplete(uint64_t ticket) const;
+	bool     IsIdle() const;
+	// Bytes copied by the last Process().
+	size_t   GetUploadedBytes() const;
+	// Bytes queued and not yet copied.
+	size_t   GetPendingBytes() const;
+	// Frames in which Process() found its staging region still in use by the GPU.
+	unsigned int GetDeferredFrames() const;
+
+private:
+	struct Request
+	{
+		uint64_t                   ticket;
+		// A texture when width is non-zero, otherwise a buffer.
+		unsigned int               destination;
+		size_t                     offset;
+		unsigned int               level			= 0;
+		int                        width			= 0;
+		int                        height			= 0;
+		GLenum                     format			= GL_RGBA;
+		TextureCompletion          completion		= TextureCompletion::NONE;
+		std::vector<unsigned char> data;
+		// Rows or bytes copied so far.
+		size_t                     progress			= 0;
+	};
+
+	unsigned int        ID					= 0;
+	size_t              stagingSize;
+	size_t              regionSize			= 0;
+	GLsync              fences[FRAMES_IN_FLIGHT] = { 0 };
+	unsigned int        frameIndex			= 0;
+
+	// Filled by any thread, drained into active by the render thread.
+	mutable std::mutex  mutex;
+	std::deque<Request> incoming;
+	uint64_t            nextTicket			= 1;
+	size_t              incomingBytes		= 0;
+
+	std::deque<Request> active;
+	uint64_t            completedTicket		= 0;
+	size_t              activeBytes			= 0;
+	size_t              uploadedBytes		= 0;
+	unsigned int        deferredFrames		= 0;
+
+	// Returns false if the region was still in use and wait was not set.
+	bool          ProcessRegion(size_t limit, bool wait);
+	void          TakeIncoming();
+	// Uploads the rest of a request from client memory, for rows that do not fit into a region.
+	void          UploadDirect(Request& request);
+	// Without a staging buffer, or when it cannot be mapped.
+	void          UploadAllDirect();
+	void          Finish(const Request& request);
+	static bool   IsDone(const Request& request);
+	static bool   IsCompressed(GLenum format);
+	// Texture data is copied in rows, which are rows of 4x4 blocks for compressed formats.
+	static size_t RowBytes(const Request& request);
+	static size_t RowCount(const Request& request);
+};
@@ -0,0 +1,24 @@
+#version 330 core
+
+layout (location = 0) in vec3 inPos;
+
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 timeParams;
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+// Must produce bit-identical depth to vertexShader.vert.
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(inPos, 1.0f);
+}
\ No newline at end of file
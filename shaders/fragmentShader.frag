@@ -78,6 +78,39 @@ uniform SpotLight spotLights[MAX_SPOTLIGHTS];
 
 uniform CamInfo camInfo;
 
+#ifdef TEXTURE_ARRAYS
+#define MAX_TEXTURE_ARRAYS 4
+#define MAX_MATERIALS 256
+
+struct MaterialEntry
+{
+    // x: diffuse array, y: diffuse layer, z: specular array, w: specular layer.
+    ivec4 layers;
+    // x: shininess.
+    vec4 parameters;
+};
+
+layout (std140) uniform MaterialData
+{
+    MaterialEntry materials[MAX_MATERIALS];
+};
+
+uniform sampler2DArray materialArrays[MAX_TEXTURE_ARRAYS];
+// Index into the material table, or -1 for meshes that bind their own textures.
+uniform int materialIndex;
+
+vec4 SampleMaterialArray(int array, vec3 coords)
+{
+    // Sampler arrays can only be indexed by constants in GLSL 3.30.
+    if (array == 0) return texture(materialArrays[0], coords);
+    if (array == 1) return texture(materialArrays[1], coords);
+    if (array == 2) return texture(materialArrays[2], coords);
+    return texture(materialArrays[3], coords);
+}
+#endif
+
+float shininess;
+
 vec3 CalculateDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDirection);
 vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPosition, vec3 viewDirection);
 vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPosition, vec3 viewDirection);
@@ -86,6 +119,12 @@ void main()
 { 
     vec3 normal = normalize(Normal);
 
+    shininess = material.shininess;
+#ifdef TEXTURE_ARRAYS
+    if (materialIndex >= 0)
+        shininess = materials[materialIndex].parameters.x;
+#endif
+
     vec3 totalLight = vec3(0.0f);
     for (int i = 0; i < numOfPointLights; ++i)
     {
@@ -99,7 +138,18 @@ void main()
         totalLight += CalculateSpotLight(spotLights[j], normal, FragPos, normalize(-FragPos));
     }
 
-    vec4 texColor = texture(material.texture_diffuse1, TexCoords);
+    vec4 texColor;
+#ifdef TEXTURE_ARRAYS
+    if (materialIndex >= 0)
+    {
+        ivec4 layers = materials[materialIndex].layers;
+        texColor = SampleMaterialArray(layers.x, vec3(TexCoords, float(layers.y)));
+    }
+    else
+        texColor = texture(material.texture_diffuse1, TexCoords);
+#else
+    texColor = texture(material.texture_diffuse1, TexCoords);
+#endif
     FragColor = vec4(totalLight, 1.0f) * texColor;
 }
 
@@ -111,7 +161,7 @@ vec3 CalculateDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir
     vec3 diffuse = max(dot(normal, lightDirection), 0.0) * light.diffuse;
 
     vec3 reflectDirection = reflect(-lightDirection, normal);
-    vec3 specular = pow(max(dot(viewDirection, reflectDirection), 0.0), material.shininess) * light.specular;
+    vec3 specular = pow(max(dot(viewDirection, reflectDirection), 0.0), shininess) * light.specular;
 
     return (ambient + diffuse + specular);
 }
@@ -124,7 +174,7 @@ vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPosition, vec3
     vec3 diffuse = max(dot(normal, lightDirection), 0.0) * light.diffuse;
 
     vec3 reflectDirection = reflect(-lightDirection, normal);
-    vec3 specular = pow(max(dot(viewDirection, reflectDirection), 0.0), material.shininess) * light.specular;
+    vec3 specular = pow(max(dot(viewDirection, reflectDirection), 0.0), shininess) * light.specular;
 
     float distance = length(light.position - fragPosition);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
@@ -146,7 +196,7 @@ vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPosition, vec3 vi
     vec3 diffuse = max(dot(normal, lightDirection), 0.0) * light.diffuse;
 
     vec3 reflectDirection = reflect(-lightDirection, normal);
-    vec3 specular = pow(max(dot(lightDirection, reflectDirection), 0.0), material.shininess) * light.specular;
+    vec3 specular = pow(max(dot(lightDirection, reflectDirection), 0.0), shininess) * light.specular;
 
     float distance = length(light.position - fragPosition);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
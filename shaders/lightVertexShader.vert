@@ -4,9 +4,18 @@ layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inTexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 timeParams;
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 model;
+    mat4 normalMatrix;
+};
 
 void main()
 {
@@ -0,0 +1,42 @@
+#version 330 core 
+out vec4 FragColor; 
+
+const int MAX_OUTLINE_COLORS = 64;
+
+uniform sampler2D outlineMask;
+uniform int outlineWidth;
+uniform vec3 outlineColors[MAX_OUTLINE_COLORS];
+
+const ivec2 directions[8] = ivec2[] (
+    ivec2(1, 0), ivec2(-1, 0), ivec2(0, 1), ivec2(0, -1),
+    ivec2(1, 1), ivec2(-1, 1), ivec2(1, -1), ivec2(-1, -1)
+);
+
+// The mask has the size of the target, so it is read texel by texel. Filtering would blend neighbouring ids.
+int sampleId(ivec2 texel)
+{
+    texel = clamp(texel, ivec2(0), textureSize(outlineMask, 0) - 1);
+    return int(texelFetch(outlineMask, texel, 0).r * 255.0f + 0.5f);
+}
+
+// Pixels outside every outlined entity take the color of the closest entity within outlineWidth pixels.
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    if (sampleId(texel) != 0)
+        discard;
+
+    for (int distance = 1; distance <= outlineWidth; ++distance)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            int id = sampleId(texel + directions[i] * distance);
+            if (id != 0)
+            {
+                FragColor = vec4(outlineColors[min(id, MAX_OUTLINE_COLORS) - 1], 1.0f);
+                return;
+            }
+        }
+    }
+    discard;
+}
\ No newline at end of file
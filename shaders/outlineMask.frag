@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// Index of the entity in the outline color table, starting at 1. 0 marks pixels without an outlined entity.
+uniform float objectId;
+
+void main()
+{
+    FragColor = vec4(objectId / 255.0f, 0.0f, 0.0f, 1.0f);
+}
\ No newline at end of file
@@ -4,38 +4,23 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D screenTexture;
+uniform vec2 texelSize;
+// (1, 0) for the horizontal pass, (0, 1) for the vertical one.
+uniform vec2 direction;
 
-const float offset = 1.0f/ 300.0f;
+// One direction of a 9 tap Gaussian. Neighbouring taps are merged into one bilinear fetch placed between them by
+// their weights, which leaves 5 fetches.
+const float offsets[3] = float[] (0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[] (0.2270270270, 0.3162162162, 0.0702702703);
 
 void main()
 {
-    vec2 offsets[9] = vec2[] (
-        vec2(-offset, offset),  // top-left
-        vec2(0.0f,    offset),  // top-center 
-        vec2(offset,  offset),  // top-right
-        vec2(-offset, 0.0f),    // center-left 
-        vec2(0.0f,    0.0f),    // center-center 
-        vec2(offset,  0.0f),    // center-right 
-        vec2(-offset, -offset), // bottom-left 
-        vec2(0.0f,    -offset), // bottom-center 
-        vec2(offset,  -offset)  // bottom-right
-    );
-
-    float kernel[9] = float[] (
-        1.0 / 16, 2.0 / 16, 1.0 / 16,
-        2.0 / 16,  4.0 / 16, 2.0 / 16,
-        1.0 / 16, 2.0 / 16, 1.0 / 16
-    );
-
-    vec3 sampleTex[9];
-    for (int i = 0; i < 9; ++i)
-    {
-        sampleTex[i] = vec3(texture(screenTexture, TexCoords.st + offsets[i]));
-    }
-    vec3 col = vec3(0.0f);
-    for (int i = 0; i < 9; ++i)
+    vec3 col = texture(screenTexture, TexCoords).rgb * weights[0];
+    for (int i = 1; i < 3; ++i)
     {
-        col += sampleTex[i] * kernel[i];
+        vec2 offset = direction * texelSize * offsets[i];
+        col += texture(screenTexture, TexCoords + offset).rgb * weights[i];
+        col += texture(screenTexture, TexCoords - offset).rgb * weights[i];
     }
     FragColor = vec4(col, 1.0f);
 }
\ No newline at end of file
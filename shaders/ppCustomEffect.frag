@@ -5,12 +5,19 @@ in vec2 TexCoords;
 
 uniform sampler2D screenTexture;
 
-uniform float t;
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 timeParams;
+};
 
 const float offset = 1.0f/ 300.0f;
 
 void main()
 {
+    float t = timeParams.x;
+
     vec2 offsets[9] = vec2[] (
         vec2(-offset, offset),  // top-left
         vec2(0.0f,    offset),  // top-center 
@@ -0,0 +1,24 @@
+#version 330 core 
+out vec4 FragColor; 
+
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+uniform vec2 texelSize;
+uniform float sharpness;
+
+// Bilinear upscale followed by an unsharp mask over the source texel's neighbours. The result is clamped to the
+// neighbourhood so sharpening cannot ring around edges.
+void main()
+{
+    vec3 center = texture(screenTexture, TexCoords).rgb;
+    vec3 north = texture(screenTexture, TexCoords + vec2(0.0, texelSize.y)).rgb;
+    vec3 south = texture(screenTexture, TexCoords - vec2(0.0, texelSize.y)).rgb;
+    vec3 east = texture(screenTexture, TexCoords + vec2(texelSize.x, 0.0)).rgb;
+    vec3 west = texture(screenTexture, TexCoords - vec2(texelSize.x, 0.0)).rgb;
+
+    vec3 minimum = min(center, min(min(north, south), min(east, west)));
+    vec3 maximum = max(center, max(max(north, south), max(east, west)));
+    vec3 col = center + sharpness * (4.0 * center - north - south - east - west);
+    FragColor = vec4(clamp(col, minimum, maximum), 1.0f);
+}
\ No newline at end of file